@@ -0,0 +1,83 @@
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+#ifndef NDEBUG
+
+/* Replacing the global allocation functions lets debug builds count every allocation without
+ * touching the callers. Plain malloc/free underneath, like the default implementation. */
+
+static thread_local std::size_t allocations = 0;
+
+void *operator new(std::size_t size) {
+    ++allocations;
+    void *p = std::malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    ++allocations;
+    std::size_t align = static_cast<std::size_t>(alignment);
+    /* aligned_alloc wants a multiple of the alignment */
+    void *p = std::aligned_alloc(align, (size + align - 1) / align * align);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+std::size_t thread_allocations() {
+    return allocations;
+}
+
+#else
+
+std::size_t thread_allocations() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstddef>
+
+/* Number of heap allocations the calling thread made through operator new so far. Only counted in
+ * debug builds (without NDEBUG), always 0 otherwise. */
+std::size_t thread_allocations();
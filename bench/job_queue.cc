@@ -0,0 +1,169 @@
+/* Enqueue-to-dequeue cost per job of the task job queues compared with the std::queue they
+ * replaced.
+ *
+ * usage: job_queue [n_jobs] [producer_cpu] [consumer_cpu] */
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+
+#include <sched.h>
+
+#include "job_queue.h"
+
+using namespace std::chrono_literals;
+using duration = typename std::chrono::nanoseconds;
+
+/* what gets passed around per job in sched_sim */
+struct Payload {
+    int _id;
+    long _execution_time;
+    long _deadline;
+    long _submission_time;
+    int _task_id;
+};
+
+static void pin(int cpu) {
+    if (cpu < 0) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+        perror("sched_setaffinity");
+        exit(-1);
+    }
+}
+
+/* std::queue as used before, without synchronisation. Only meaningful single threaded */
+class UnsyncedQueue {
+    std::queue<Payload> _queue;
+  public:
+    bool try_push(const Payload &p) {
+        this->_queue.push(p);
+        return true;
+    }
+
+    bool try_pop(Payload *p) {
+        if (this->_queue.empty()) {
+            return false;
+        }
+        *p = this->_queue.front();
+        this->_queue.pop();
+        return true;
+    }
+};
+
+/* the cheapest correct way to share a std::queue between two threads */
+class LockedQueue {
+    std::mutex _mutex;
+    std::queue<Payload> _queue;
+  public:
+    bool try_push(const Payload &p) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_queue.push(p);
+        return true;
+    }
+
+    bool try_pop(Payload *p) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        if (this->_queue.empty()) {
+            return false;
+        }
+        *p = this->_queue.front();
+        this->_queue.pop();
+        return true;
+    }
+};
+
+/* push and immediately pop on one thread: the raw cost of the data structure */
+template <typename Queue>
+static duration single_threaded(Queue *queue, long n_jobs) {
+    Payload p{};
+    long sum = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (long i = 0; i < n_jobs; ++i) {
+        p._id = i;
+        queue->try_push(p);
+        queue->try_pop(&p);
+        sum += p._id;
+    }
+    auto end = std::chrono::steady_clock::now();
+    if (sum != n_jobs * (n_jobs - 1) / 2) {
+        std::cerr << "lost jobs" << std::endl;
+        exit(-1);
+    }
+    return (end - begin) / n_jobs;
+}
+
+/* one thread pushes, another pops: includes the cache line transfers between the cores */
+template <typename Queue>
+static duration cross_thread(Queue *queue, long n_jobs, int producer_cpu, int consumer_cpu) {
+    long sum = 0;
+    std::thread consumer([&] {
+        pin(consumer_cpu);
+        Payload p;
+        for (long i = 0; i < n_jobs; ++i) {
+            while (not queue->try_pop(&p)) {
+                std::this_thread::yield();
+            }
+            sum += p._id;
+        }
+    });
+
+    pin(producer_cpu);
+    Payload p{};
+    auto begin = std::chrono::steady_clock::now();
+    for (long i = 0; i < n_jobs; ++i) {
+        p._id = i;
+        while (not queue->try_push(p)) {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+    auto end = std::chrono::steady_clock::now();
+    if (sum != n_jobs * (n_jobs - 1) / 2) {
+        std::cerr << "lost jobs" << std::endl;
+        exit(-1);
+    }
+    return (end - begin) / n_jobs;
+}
+
+int main(int argc, char *argv[]) {
+    long n_jobs = argc > 1 ? std::stol(argv[1]) : 10'000'000;
+    int producer_cpu = argc > 2 ? std::stoi(argv[2]) : -1;
+    int consumer_cpu = argc > 3 ? std::stoi(argv[3]) : -1;
+
+    std::cout << "jobs: " << n_jobs << std::endl;
+    std::cout << "queue                 single thread [ns/job]  cross thread [ns/job]" << std::endl;
+
+    {
+        UnsyncedQueue q;
+        std::cout << "std::queue (unsynced) " << single_threaded(&q, n_jobs).count()
+                  << "\t\t\t-" << std::endl;
+    }
+    {
+        LockedQueue q;
+        duration st = single_threaded(&q, n_jobs);
+        std::cout << "std::queue + mutex    " << st.count() << "\t\t\t"
+                  << cross_thread(&q, n_jobs, producer_cpu, consumer_cpu).count() << std::endl;
+    }
+    {
+        SpscRing<Payload> q;
+        duration st = single_threaded(&q, n_jobs);
+        std::cout << "SpscRing              " << st.count() << "\t\t\t"
+                  << cross_thread(&q, n_jobs, producer_cpu, consumer_cpu).count() << std::endl;
+    }
+    {
+        MpscRing<Payload> q;
+        duration st = single_threaded(&q, n_jobs);
+        std::cout << "MpscRing              " << st.count() << "\t\t\t"
+                  << cross_thread(&q, n_jobs, producer_cpu, consumer_cpu).count() << std::endl;
+    }
+
+    return 0;
+}
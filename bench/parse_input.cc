@@ -0,0 +1,96 @@
+/* Startup cost of reading a sched_sim input file: the mmap/from_chars parser against the
+ * getline/stringstream parser it replaced, on a generated file.
+ *
+ * usage: parse_input [n_jobs] [path] */
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "sim_input.h"
+
+using namespace std::chrono_literals;
+using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+
+constexpr int n_tasks = 16;
+
+/* n_jobs jobs spread round robin over n_tasks periodic tasks */
+static void generate(const std::string &path, long n_jobs) {
+    FILE *file = fopen(path.c_str(), "w");
+    if (not file) {
+        perror("fopen");
+        exit(-1);
+    }
+    fprintf(file, "c 4\n");
+    for (int task = 0; task < n_tasks; ++task) {
+        fprintf(file, "S %d %d %d\n", task, 100 + task * 10, 1000 * (task + 1));
+    }
+    for (long i = 0; i < n_jobs; ++i) {
+        int task = i % n_tasks;
+        long job = i / n_tasks;
+        fprintf(file, "j %ld %d %ld %d\n", job, 100 + task * 10 + static_cast<int>(job % 7),
+                job * 1000 * (task + 1), task);
+    }
+    fclose(file);
+}
+
+/* the parser sched_sim used before, reduced to what it produced */
+static SimInput parse_with_streams(const std::string &path) {
+    SimInput input;
+    std::ifstream input_file(path);
+    std::string line;
+    while (std::getline(input_file, line)) {
+        std::stringstream ss(line);
+        char type = ' ';
+        ss >> type;
+        switch (type) {
+            break; case 'c': ss >> input.n_cores;
+            break; case 'j': {
+                int id, execution_time, submission_time, task_id;
+                ss >> id >> execution_time >> submission_time >> task_id;
+                /* the task id stays unresolved, as it was */
+                input.jobs.push_back(Job{id, static_cast<uint32_t>(task_id), execution_time * 1us,
+                                         time_point{0us}, time_point{submission_time * 1us}});
+            }
+            break; case 'S': {
+                int id, execution_time, period;
+                ss >> id >> execution_time >> period;
+                input.tasks.push_back(TaskLoad{id, execution_time * 1us, period * 1us});
+            }
+            break; default:
+                break;
+        }
+    }
+    return input;
+}
+
+template <typename Parse>
+static void measure(const char *name, Parse parse, const std::string &path) {
+    auto start = std::chrono::steady_clock::now();
+    SimInput input = parse(path);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << name << seconds * 1000 << " ms\t" << input.jobs.size() / seconds / 1e6
+              << " M jobs/s\t(" << input.jobs.size() << " jobs, " << input.tasks.size()
+              << " tasks)" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    long n_jobs = argc > 1 ? std::stol(argv[1]) : 10'000'000;
+    std::string path = argc > 2 ? argv[2] : "/tmp/sched_sim_parse_input.txt";
+
+    std::cout << "generating " << n_jobs << " jobs in " << path << std::endl;
+    generate(path, n_jobs);
+
+    /* the first read pulls the file into the page cache for both */
+    parse_sim_input(path);
+    measure("getline + stringstream  ", parse_with_streams, path);
+    measure("mmap + from_chars       ", parse_sim_input, path);
+
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,82 @@
+/* Time from parsed jobs to numbered jobs in spawn order: numbering followed by std::sort as
+ * sched_sim does for small inputs, against number_and_sort_jobs on a growing number of threads.
+ *
+ * usage: sort_jobs [n_jobs] [n_tasks] */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "job_sort.h"
+
+using namespace std::chrono_literals;
+using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+
+/* periodic tasks whose jobs are interleaved like in a trace: every task's jobs in submission
+ * order, but the tasks' submissions jittered against each other */
+static SimInput generate(long n_jobs, uint32_t n_tasks) {
+    SimInput input;
+    std::mt19937 random(1);
+    for (uint32_t task = 0; task < n_tasks; ++task) {
+        input.tasks.push_back(TaskLoad{static_cast<int>(task), 100us,
+                                       std::uniform_int_distribution<long>(1000, 20'000)(random)
+                                       * 1us});
+    }
+    std::vector<long> next(n_tasks);
+    std::uniform_int_distribution<uint32_t> pick(0, n_tasks - 1);
+    input.jobs.reserve(n_jobs);
+    for (long i = 0; i < n_jobs; ++i) {
+        uint32_t task = pick(random);
+        input.jobs.push_back(Job{0, task, 100us, time_point(0us),
+                                 time_point(next[task] * input.tasks[task].period)});
+        ++next[task];
+    }
+    return input;
+}
+
+static void sequential(std::vector<Job> *jobs, const std::vector<TaskLoad> &tasks) {
+    std::vector<JobNumbering> numbering(tasks.size());
+    for (Job &job: *jobs) {
+        numbering[job._task].number(tasks[job._task], &job);
+    }
+    std::sort(jobs->begin(), jobs->end(), [](const Job &a, const Job &b) {
+        return std::tie(a._submission_time, a._task, a._id)
+               < std::tie(b._submission_time, b._task, b._id);
+    });
+}
+
+template <typename Sort>
+static double measure(const SimInput &input, Sort sort) {
+    std::vector<Job> jobs = input.jobs;
+    auto begin = std::chrono::steady_clock::now();
+    sort(&jobs);
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin)
+           .count();
+}
+
+int main(int argc, char *argv[]) {
+    long n_jobs = argc > 1 ? std::stol(argv[1]) : 50'000'000;
+    uint32_t n_tasks = argc > 2 ? std::stoul(argv[2]) : 1000;
+
+    SimInput input = generate(n_jobs, n_tasks);
+    std::cout << "jobs: " << n_jobs << ", tasks: " << n_tasks << std::endl;
+
+    std::cout << "number + std::sort       "
+              << measure(input, [&](std::vector<Job> *jobs) { sequential(jobs, input.tasks); })
+              << " ms" << std::endl;
+    unsigned max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+        std::cout << "number_and_sort_jobs " << n_threads << "\t"
+                  << measure(input, [&](std::vector<Job> *jobs) {
+                         number_and_sort_jobs(jobs, input.tasks, n_threads);
+                     })
+                  << " ms" << std::endl;
+    }
+
+    return 0;
+}
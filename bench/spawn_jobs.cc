@@ -0,0 +1,141 @@
+/* Per-job cost of the spawn loop with many tasks: finding the next batch, looking up its task and
+ * handing the jobs over, without waiting for submission times. The job table with dense task
+ * indices against the job vector and std::map task lookup it replaced.
+ *
+ * usage: spawn_jobs [n_tasks] [n_jobs] */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "futex_semaphore.h"
+#include "job_queue.h"
+#include "sim_input.h"
+
+using namespace std::chrono_literals;
+using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+using duration = typename std::chrono::nanoseconds;
+
+/* the job as sched_sim kept it before, referring to its task by id */
+struct OldJob {
+    int _id;
+    duration _execution_time;
+    time_point _deadline;
+    time_point _submission_time;
+    int _task_id;
+};
+
+/* the producer side of a task: its job ring and semaphore. Nobody consumes, so a full ring is
+ * emptied on the spot, the same way for both loops */
+template <typename T>
+struct Consumer {
+    SpscRing<T> jobs;
+    FutexSemaphore sem{0};
+
+    void add_jobs(std::span<const T> batch) {
+        for (const T &job: batch) {
+            if (not this->jobs.try_push(job)) {
+                T dropped;
+                while (this->jobs.try_pop(&dropped)) {
+                }
+                this->jobs.try_push(job);
+            }
+        }
+        this->sem.release(batch.size());
+    }
+};
+
+/* periodic jobs of n_tasks tasks with random periods, sorted into spawn order */
+static std::vector<Job> generate(uint32_t n_tasks, long n_jobs) {
+    std::mt19937 random(1);
+    std::vector<duration> periods(n_tasks);
+    double rate = 0;
+    for (duration &period: periods) {
+        period = std::uniform_int_distribution<long>(1000, 100'000)(random) * 1us;
+        rate += 1.0 / period.count();
+    }
+    duration length(static_cast<long>(n_jobs / rate));
+
+    std::vector<Job> jobs;
+    for (uint32_t task = 0; task < n_tasks; ++task) {
+        int id = 0;
+        for (duration t(0); t < length; t += periods[task], ++id) {
+            jobs.push_back(Job{id, task, periods[task] / 10, time_point(t + periods[task]),
+                               time_point(t)});
+        }
+    }
+    std::sort(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) {
+        return std::tie(a._submission_time, a._task, a._id)
+               < std::tie(b._submission_time, b._task, b._id);
+    });
+    return jobs;
+}
+
+/* the loop as it was: scans 40 byte jobs and looks every batch's task up by id */
+static duration old_loop(const std::vector<OldJob> &jobs,
+                         std::map<int, Consumer<OldJob> *> &tasks) {
+    auto begin = std::chrono::steady_clock::now();
+    std::span<const OldJob> all(jobs);
+    for (std::size_t next = 0; next < all.size();) {
+        const OldJob &first = all[next];
+        std::size_t end = next + 1;
+        while (end < all.size() and all[end]._submission_time == first._submission_time
+               and all[end]._task_id == first._task_id) {
+            ++end;
+        }
+        tasks[first._task_id]->add_jobs(all.subspan(next, end - next));
+        next = end;
+    }
+    return (std::chrono::steady_clock::now() - begin) / jobs.size();
+}
+
+static duration table_loop(JobTable *table, const std::vector<Consumer<Job> *> &tasks) {
+    auto begin = std::chrono::steady_clock::now();
+    for (std::span<const Job> batch = table->next_batch(); not batch.empty();
+         batch = table->next_batch()) {
+        tasks[batch.front()._task]->add_jobs(batch);
+    }
+    return (std::chrono::steady_clock::now() - begin) / table->size();
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t n_tasks = argc > 1 ? std::stoul(argv[1]) : 10'000;
+    long n_jobs = argc > 2 ? std::stol(argv[2]) : 10'000'000;
+
+    std::vector<Job> jobs = generate(n_tasks, n_jobs);
+    std::cout << "tasks: " << n_tasks << ", jobs: " << jobs.size() << std::endl;
+
+    /* task ids as sparse as in real inputs */
+    std::vector<OldJob> old_jobs;
+    old_jobs.reserve(jobs.size());
+    for (const Job &job: jobs) {
+        old_jobs.push_back(OldJob{job._id, job._execution_time, job._deadline,
+                                  job._submission_time, static_cast<int>(job._task * 7 + 3)});
+    }
+    std::map<int, Consumer<OldJob> *> old_tasks;
+    std::vector<Consumer<Job> *> tasks;
+    for (uint32_t task = 0; task < n_tasks; ++task) {
+        old_tasks[task * 7 + 3] = new Consumer<OldJob>;
+        tasks.push_back(new Consumer<Job>);
+    }
+
+    /* best of three, the first run also warms up the rings */
+    duration old_best = duration::max();
+    duration table_best = duration::max();
+    for (int run = 0; run < 3; ++run) {
+        old_best = std::min(old_best, old_loop(old_jobs, old_tasks));
+        JobTable table(jobs);
+        table_best = std::min(table_best, table_loop(&table, tasks));
+    }
+    std::cout << "vector<Job> + std::map   " << old_best.count() << " ns/job" << std::endl;
+    std::cout << "JobTable + task index    " << table_best.count() << " ns/job" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+/* Cost per task of getting a pinned thread that runs the task and finishes: a dedicated thread as
+ * TaskBase creates without a pool, against the threads of a TaskThreadPool. The pool is used for
+ * several rounds of tasks, as it would be over task lifetimes. Task bodies are empty.
+ *
+ * usage: task_threads [n_tasks] [rounds] [cpu] */
+
+#include <chrono>
+#include <iostream>
+#include <latch>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+
+#include "task_pool.h"
+
+using namespace std::chrono_literals;
+using duration = typename std::chrono::nanoseconds;
+
+static void pin(int cpu) {
+    if (cpu < 0) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+        perror("sched_setaffinity");
+        exit(-1);
+    }
+}
+
+/* create, pin and join a thread per task */
+static duration dedicated(long n_tasks, int rounds, int cpu) {
+    auto begin = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        std::vector<std::thread> threads;
+        threads.reserve(n_tasks);
+        for (long i = 0; i < n_tasks; ++i) {
+            threads.emplace_back(pin, cpu);
+        }
+        for (std::thread &thread: threads) {
+            thread.join();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return (end - begin) / (n_tasks * rounds);
+}
+
+static void count_down(void *done) {
+    static_cast<std::latch *>(done)->count_down();
+}
+
+/* the first round creates the threads unless they are prestarted, later ones reuse them */
+static duration pooled(long n_tasks, int rounds, int cpu, std::size_t prestart) {
+    std::vector<unsigned> cpus;
+    if (cpu >= 0) {
+        cpus.push_back(cpu);
+    }
+    TaskThreadPool pool(cpus, prestart);
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        std::latch done(n_tasks);
+        for (long i = 0; i < n_tasks; ++i) {
+            pool.run(count_down, &done);
+        }
+        done.wait();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return (end - begin) / (n_tasks * rounds);
+}
+
+int main(int argc, char *argv[]) {
+    long n_tasks = argc > 1 ? std::stol(argv[1]) : 1000;
+    int rounds = argc > 2 ? std::stoi(argv[2]) : 10;
+    int cpu = argc > 3 ? std::stoi(argv[3]) : -1;
+
+    std::cout << "tasks: " << n_tasks << ", rounds: " << rounds << std::endl;
+    std::cout << "threads                      [ns/task]" << std::endl;
+    std::cout << "dedicated                    " << dedicated(n_tasks, rounds, cpu).count()
+              << std::endl;
+    std::cout << "pool, created on demand      " << pooled(n_tasks, rounds, cpu, 0).count()
+              << std::endl;
+    std::cout << "pool, prestarted             " << pooled(n_tasks, rounds, cpu, n_tasks).count()
+              << std::endl;
+
+    return 0;
+}
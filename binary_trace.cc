@@ -0,0 +1,364 @@
+#include "binary_trace.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <tuple>
+
+using namespace std::chrono_literals;
+using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+using duration = std::chrono::nanoseconds;
+
+
+static constexpr char binary_trace_magic[8] = "SSIMTRC";
+
+struct BinaryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_cores;
+    uint32_t n_tasks;
+    uint32_t n_interference;
+    uint64_t n_jobs;
+};
+
+struct BinaryTask {
+    int32_t id;
+    uint32_t kernel;
+    uint64_t execution_time;
+    uint64_t period;
+    uint64_t deadline;
+    uint64_t min_interarrival;
+};
+
+/* task records before version 4 */
+static constexpr std::size_t binary_task_v3_size = 24;
+
+struct BinaryInterference {
+    uint64_t cpus;
+    uint32_t type;
+    uint32_t percent;
+    uint64_t footprint;
+};
+
+struct BinaryJob {
+    uint64_t submission_time;
+    uint32_t execution_time;
+    uint16_t task;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(BinaryHeader) == 32);
+static_assert(sizeof(BinaryTask) == 40);
+static_assert(sizeof(BinaryInterference) == 24);
+static_assert(sizeof(BinaryJob) == binary_job_size);
+
+/* converts between host and file byte order, in both directions */
+template <typename Int>
+static Int little_endian(Int value) {
+    if constexpr (std::endian::native == std::endian::little) {
+        return value;
+    } else {
+        Int swapped;
+        auto from = reinterpret_cast<const unsigned char *>(&value);
+        auto to = reinterpret_cast<unsigned char *>(&swapped);
+        for (std::size_t i = 0; i < sizeof(Int); ++i) {
+            to[i] = from[sizeof(Int) - 1 - i];
+        }
+        return swapped;
+    }
+}
+
+[[noreturn]] static void trace_error(const std::string &path, const std::string &message) {
+    std::cerr << "Trace error: " << path << ": " << message << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+bool is_binary_trace(const MappedFile &file) {
+    return file.size() >= sizeof(BinaryHeader)
+           and std::memcmp(file.begin(), binary_trace_magic, sizeof(binary_trace_magic)) == 0;
+}
+
+const char *read_binary_trace_header(const MappedFile &file, const std::string &path,
+                                     SimInput *input, uint64_t *n_jobs) {
+    BinaryHeader header;
+    std::memcpy(&header, file.begin(), sizeof(header));
+    if (little_endian(header.version) > binary_trace_version) {
+        trace_error(path, "version " + std::to_string(little_endian(header.version))
+                          + " is newer than this sched_sim");
+    }
+    std::size_t task_size = little_endian(header.version) < 4 ? binary_task_v3_size
+                                                              : sizeof(BinaryTask);
+    uint32_t n_tasks = little_endian(header.n_tasks);
+    uint32_t n_interference = little_endian(header.n_interference);
+    *n_jobs = little_endian(header.n_jobs);
+    if (file.size() != sizeof(BinaryHeader) + n_tasks * task_size
+                       + n_interference * sizeof(BinaryInterference)
+                       + *n_jobs * sizeof(BinaryJob)) {
+        trace_error(path, "size does not match the header");
+    }
+
+    input->n_cores = little_endian(header.n_cores);
+    input->numbered = true;
+
+    const char *pos = file.begin() + sizeof(BinaryHeader);
+    input->tasks.reserve(n_tasks);
+    for (uint32_t i = 0; i < n_tasks; ++i, pos += task_size) {
+        BinaryTask task = {};
+        std::memcpy(&task, pos, task_size);
+        int32_t id = little_endian(task.id);
+        uint32_t kernel = little_endian(task.kernel);
+        if (kernel) {
+            KernelSpec spec;
+            spec.type = static_cast<KernelType>(kernel & 0xff);
+            spec.footprint = static_cast<std::size_t>(kernel >> 8) << 10;
+            if (spec.type > KernelType::branchy) {
+                trace_error(path, "unknown kernel of task " + std::to_string(id));
+            }
+            input->kernels[id] = spec;
+        }
+        input->tasks.push_back(TaskLoad{id,
+                                        little_endian(task.execution_time) * 1us,
+                                        little_endian(task.period) * 1us,
+                                        little_endian(task.deadline) * 1us,
+                                        little_endian(task.min_interarrival) * 1us});
+    }
+
+    for (uint32_t i = 0; i < n_interference; ++i, pos += sizeof(BinaryInterference)) {
+        BinaryInterference record;
+        std::memcpy(&record, pos, sizeof(record));
+        InterferenceSpec spec;
+        uint64_t cpus = little_endian(record.cpus);
+        for (unsigned cpu = 0; cpu < 64; ++cpu) {
+            if (cpus & uint64_t(1) << cpu) {
+                spec.cpus.push_back(cpu);
+            }
+        }
+        spec.type = static_cast<InterferenceType>(little_endian(record.type));
+        spec.percent = little_endian(record.percent);
+        spec.footprint = little_endian(record.footprint);
+        if (spec.type > InterferenceType::syscall) {
+            trace_error(path, "unknown interference type");
+        }
+        input->interference.push_back(spec);
+    }
+    return pos;
+}
+
+Job read_binary_job(const char *pos, const SimInput &input, const std::string &path) {
+    BinaryJob job;
+    std::memcpy(&job, pos, sizeof(job));
+    uint16_t task = little_endian(job.task);
+    if (task >= input.tasks.size()) {
+        trace_error(path, "job record refers to a missing task");
+    }
+    return Job{0, task, little_endian(job.execution_time) * 1us, time_point{0us},
+               time_point{little_endian(job.submission_time) * 1us}};
+}
+
+SimInput read_binary_trace(const MappedFile &file, const std::string &path) {
+    SimInput input;
+    uint64_t n_jobs;
+    const char *pos = read_binary_trace_header(file, path, &input, &n_jobs);
+
+    std::vector<JobNumbering> numbering(input.tasks.size());
+    input.jobs.reserve(n_jobs);
+    for (uint64_t i = 0; i < n_jobs; ++i, pos += sizeof(BinaryJob)) {
+        Job job = read_binary_job(pos, input, path);
+        numbering[job._task].number(input.tasks[job._task], &job);
+        input.jobs.push_back(job);
+    }
+
+    return input;
+}
+
+/* Jobs of input sorted by submission time, with their ids and deadlines as sched_sim numbers
+ * them: per task in the order of the input. Sorting must keep that order within every task, or the
+ * numbering of a re-read file and with it the deadlines would change. */
+static std::vector<Job> numbered_jobs(const std::string &path, const SimInput &input) {
+    std::vector<Job> jobs = input.jobs;
+    if (not input.numbered) {
+        std::vector<JobNumbering> numbering(input.tasks.size());
+        for (Job &job: jobs) {
+            numbering[job._task].number(input.tasks[job._task], &job);
+        }
+    }
+    /* the order sched_sim spawns in, so it need not sort again */
+    std::sort(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) {
+        return std::tie(a._submission_time, a._task, a._id)
+               < std::tie(b._submission_time, b._task, b._id);
+    });
+
+    std::vector<int> last_id(input.tasks.size(), -1);
+    for (const Job &job: jobs) {
+        if (last_id[job._task] > job._id) {
+            trace_error(path, "jobs of task " + std::to_string(input.tasks[job._task].id)
+                              + " are not in submission order, sorting would change deadlines");
+        }
+        last_id[job._task] = job._id;
+    }
+    return jobs;
+}
+
+/* The relative deadline of every one of the numbered jobs that has its own, zero for those that
+ * use their task's */
+static std::vector<duration> job_deadlines(const SimInput &input, const std::vector<Job> &jobs) {
+    std::vector<JobNumbering> numbering(input.tasks.size());
+    std::vector<duration> deadlines;
+    deadlines.reserve(jobs.size());
+    for (const Job &job: jobs) {
+        const TaskLoad &task = input.tasks[job._task];
+        time_point release = numbering[job._task].release(task, job._submission_time);
+        Job renumbered = job;
+        renumbered._deadline = time_point{};
+        numbering[job._task].number(task, &renumbered);
+
+        duration deadline = job._deadline - release;
+        deadlines.push_back(deadline == task.relative_deadline() ? 0ns : deadline);
+    }
+    return deadlines;
+}
+
+static FILE *open_output(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "w");
+    if (not file) {
+        perror(path.c_str());
+        exit(-1);
+    }
+    return file;
+}
+
+static void close_output(FILE *file, const std::string &path) {
+    if (ferror(file) or fclose(file) != 0) {
+        trace_error(path, "write failed");
+    }
+}
+
+void write_binary_trace(const std::string &path, const SimInput &input) {
+    if (input.tasks.size() > std::numeric_limits<uint16_t>::max()) {
+        trace_error(path, "more tasks than the format can index");
+    }
+    std::vector<Job> jobs = numbered_jobs(path, input);
+    for (duration deadline: job_deadlines(input, jobs)) {
+        if (deadline != 0ns) {
+            trace_error(path, "jobs with deadlines of their own need the text format");
+        }
+    }
+
+    FILE *file = open_output(path);
+
+    BinaryHeader header = {};
+    std::memcpy(header.magic, binary_trace_magic, sizeof(header.magic));
+    header.version = little_endian(binary_trace_version);
+    header.n_cores = little_endian<uint32_t>(input.n_cores);
+    header.n_tasks = little_endian<uint32_t>(input.tasks.size());
+    header.n_interference = little_endian<uint32_t>(input.interference.size());
+    header.n_jobs = little_endian<uint64_t>(jobs.size());
+    fwrite(&header, sizeof(header), 1, file);
+
+    for (const TaskLoad &task: input.tasks) {
+        BinaryTask record = {};
+        record.id = little_endian<int32_t>(task.id);
+        auto kernel = input.kernels.find(task.id);
+        if (kernel != input.kernels.end()) {
+            std::size_t footprint = kernel->second.footprint >> 10;
+            if (footprint << 10 != kernel->second.footprint or footprint >= 1 << 24) {
+                trace_error(path, "footprint of task " + std::to_string(task.id)
+                                  + " does not fit the format");
+            }
+            record.kernel = little_endian<uint32_t>(
+                                static_cast<uint32_t>(kernel->second.type) | footprint << 8);
+        }
+        record.execution_time = little_endian<uint64_t>(task.execution_time / 1us);
+        record.period = little_endian<uint64_t>(task.period / 1us);
+        record.deadline = little_endian<uint64_t>(task.deadline / 1us);
+        record.min_interarrival = little_endian<uint64_t>(task.min_interarrival / 1us);
+        fwrite(&record, sizeof(record), 1, file);
+    }
+
+    for (const InterferenceSpec &spec: input.interference) {
+        BinaryInterference record = {};
+        uint64_t cpus = 0;
+        for (unsigned cpu: spec.cpus) {
+            if (cpu >= 64) {
+                trace_error(path, "interference cpus past 63 do not fit the format");
+            }
+            cpus |= uint64_t(1) << cpu;
+        }
+        record.cpus = little_endian(cpus);
+        record.type = little_endian(static_cast<uint32_t>(spec.type));
+        record.percent = little_endian<uint32_t>(spec.percent);
+        record.footprint = little_endian<uint64_t>(spec.footprint);
+        fwrite(&record, sizeof(record), 1, file);
+    }
+
+    for (const Job &job: jobs) {
+        long execution_time = job._execution_time / 1us;
+        if (execution_time < 0 or execution_time > std::numeric_limits<uint32_t>::max()
+            or job._submission_time < time_point{0us}) {
+            trace_error(path, "job " + std::to_string(job._id) + " of task "
+                              + std::to_string(input.tasks[job._task].id)
+                              + " does not fit the format");
+        }
+        BinaryJob record = {};
+        record.submission_time = little_endian<uint64_t>(
+                                     job._submission_time.time_since_epoch() / 1us);
+        record.execution_time = little_endian<uint32_t>(execution_time);
+        record.task = little_endian<uint16_t>(job._task);
+        fwrite(&record, sizeof(record), 1, file);
+    }
+
+    close_output(file, path);
+}
+
+void write_text_trace(const std::string &path, const SimInput &input) {
+    std::vector<Job> jobs = numbered_jobs(path, input);
+    std::vector<duration> deadlines = job_deadlines(input, jobs);
+    FILE *file = open_output(path);
+
+    fprintf(file, "c %d\n", input.n_cores);
+    for (const TaskLoad &task: input.tasks) {
+        fprintf(file, "S %d %ld %ld", task.id, static_cast<long>(task.execution_time / 1us),
+                static_cast<long>(task.period / 1us));
+        auto kernel = input.kernels.find(task.id);
+        if (kernel != input.kernels.end()) {
+            fprintf(file, " kernel=%s", kernel_type_name(kernel->second.type));
+            if (kernel->second.footprint) {
+                fprintf(file, " footprint=%zu", kernel->second.footprint);
+            }
+        }
+        if (task.deadline != 0ns) {
+            fprintf(file, " deadline=%ld", static_cast<long>(task.deadline / 1us));
+        }
+        if (task.min_interarrival != 0ns) {
+            fprintf(file, " min_interarrival=%ld", static_cast<long>(task.min_interarrival / 1us));
+        }
+        fprintf(file, "\n");
+    }
+    for (const InterferenceSpec &spec: input.interference) {
+        fprintf(file, "I ");
+        for (std::size_t i = 0; i < spec.cpus.size(); ++i) {
+            fprintf(file, i ? ",%u" : "%u", spec.cpus[i]);
+        }
+        fprintf(file, " %s %d", interference_type_name(spec.type), spec.percent);
+        if (spec.footprint) {
+            fprintf(file, " footprint=%zu", spec.footprint);
+        }
+        fprintf(file, "\n");
+    }
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        const Job &job = jobs[i];
+        fprintf(file, "j %d %ld %ld %d", job._id, static_cast<long>(job._execution_time / 1us),
+                static_cast<long>(job._submission_time.time_since_epoch() / 1us),
+                input.tasks[job._task].id);
+        if (deadlines[i] != 0ns) {
+            fprintf(file, " deadline=%ld", static_cast<long>(deadlines[i] / 1us));
+        }
+        fprintf(file, "\n");
+    }
+
+    close_output(file, path);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "mapped_file.h"
+#include "sim_input.h"
+
+
+/* Binary sched_sim trace. All integers are little-endian, all records fixed-width:
+ *
+ *   header        char magic[8] = "SSIMTRC", u32 version, u32 n_cores, u32 n_tasks,
+ *                 u32 n_interference, u64 n_jobs
+ *   n_tasks times i32 task id, u32 kernel, u64 execution time us, u64 period us, u64 deadline us,
+ *                 u64 minimum inter-arrival time us
+ *   n_interference times
+ *                 u64 cpu mask, u32 InterferenceType, u32 percent, u64 footprint bytes
+ *   n_jobs times  u64 submission time us, u32 execution time us, u16 task index, u16 reserved
+ *
+ * Jobs are sorted by submission time. A job's id is its position among the jobs of its task and
+ * its deadline follows from the task's just like for text input, so neither is stored. Jobs with
+ * deadlines of their own do not fit the format.
+ *
+ * The kernel field holds the KernelType in its low 8 bits and the footprint in KiB above them.
+ * Version 1 traces had 0 there, which reads as the default spin kernel. Version 3 added the
+ * interference records, older traces have a 0 count. Version 4 added the task's deadline and
+ * minimum inter-arrival time, older task records end after the period and read as 0 for both. */
+constexpr uint32_t binary_trace_version = 4;
+constexpr std::size_t binary_job_size = 16;
+
+bool is_binary_trace(const MappedFile &file);
+
+/* The jobs come out sorted and numbered. Ends the program on a malformed or newer file. */
+SimInput read_binary_trace(const MappedFile &file, const std::string &path);
+
+/* Reads core count, task table and interference into input and returns the first job record. n_jobs records of
+ * binary_job_size follow it. */
+const char *read_binary_trace_header(const MappedFile &file, const std::string &path,
+                                     SimInput *input, uint64_t *n_jobs);
+
+/* The job record at pos. Its id and deadline are left for the caller to number */
+Job read_binary_job(const char *pos, const SimInput &input, const std::string &path);
+
+/* Write input in binary or text form. Both writers sort the jobs by submission time and number
+ * them per task. Ends the program if that would change any job's deadline, or if the input does
+ * not fit the binary format's field widths. */
+void write_binary_trace(const std::string &path, const SimInput &input);
+void write_text_trace(const std::string &path, const SimInput &input);
@@ -1,14 +1,49 @@
 #include "task.h"
 #include "ctask.h"
 
-#include <functional>
+#include <algorithm>
+#include <optional>
+#include <span>
 #include <vector>
 
 using namespace std::chrono_literals;
 using time_point = std::chrono::time_point<std::chrono::steady_clock>;
 using duration = typename std::chrono::nanoseconds;
 
-std::vector<Task<void *> *> tasks;
+/* adapts C metrics generators to the task's buffer */
+struct CMetrics {
+    void (*_generate)(void *, struct metrics *) = nullptr;
+
+    std::size_t operator()(void *arg, double *data, std::size_t capacity) const {
+        if (this->_generate == nullptr) {
+            return 0;
+        }
+        struct metrics metrics = {static_cast<int>(capacity), data};
+        this->_generate(arg, &metrics);
+        return std::max(metrics.size, 0);
+    }
+};
+
+/* maps a finished job of one stage to a job of the next, see link_tasks */
+struct CForward {
+    void *(*forward)(void *) = nullptr;
+
+    std::optional<void *> operator()(void *arg) const {
+        void *job = this->forward(arg);
+        if (job == nullptr) {
+            return std::nullopt;
+        }
+        return job;
+    }
+};
+
+/* C callers may add jobs to a task from any thread */
+struct CTask : Task<void *, MpscRing, void (*)(void *), CMetrics, void (*)(void *),
+                    NoCallback<void *>, Forwarder<CTask, CForward>> {
+    using Task::Task;
+};
+
+std::vector<CTask *> tasks;
 
 static std::vector<unsigned> get_cpus(int cpus) {
     std::vector<unsigned> ret;
@@ -20,37 +55,22 @@ static std::vector<unsigned> get_cpus(int cpus) {
     return ret;
 }
 
-static std::vector<double> generate_metrics(struct metrics(*generate)(void *), void *data) {
-    std::vector<double> metrics;
-    if (generate == nullptr) {
-        return metrics;
-    }
-
-    struct metrics metrics_struct = generate(data);
-    for (int i = 0; i < metrics_struct.size; ++i) {
-        metrics.push_back(metrics_struct.data[i]);
-    }
-    delete metrics_struct.data;
-    return metrics;
-}
-
 int create_non_rt_task(int cpus, int id, void (*execute)(void *)) {
-    Task<void *> *task = new Task<void *>(id, std::function<void(void *)>(execute), get_cpus(cpus));
+    CTask *task = new CTask(id, execute, get_cpus(cpus));
     int handle = tasks.size();
     tasks.push_back(task);
     return handle;
 }
 
 int create_task(int cpus, int id, int period, void (*execute)(void *), int execution_time) {
-    Task<void *> *task = new Task<void *>(id, duration(period), std::function<void(void *)>(execute), duration(execution_time), get_cpus(cpus));
+    CTask *task = new CTask(id, duration(period), execute, duration(execution_time), get_cpus(cpus));
     int handle = tasks.size();
     tasks.push_back(task);
     return handle;
 }
 
-int create_task_with_prediction(int cpus, int id, int period, void (*execute)(void *), struct metrics(*generate)(void *)) {
-    auto gen_metrics = std::bind(generate_metrics, generate, std::placeholders::_1);
-    Task<void *> *task = new Task<void *>(id, duration(period), std::function<void(void *)>(execute), gen_metrics, get_cpus(cpus));
+int create_task_with_prediction(int cpus, int id, int period, void (*execute)(void *), void (*generate)(void *, struct metrics *)) {
+    CTask *task = new CTask(id, duration(period), execute, CMetrics{generate}, get_cpus(cpus));
     int handle = tasks.size();
     tasks.push_back(task);
     return handle;
@@ -61,6 +81,10 @@ void add_job_to_task(int task, void *arg) {
     tasks[task]->sem().release();
 }
 
+void add_jobs_to_task(int task, void **args, int n) {
+    tasks[task]->add_jobs(std::span<void * const>(args, n));
+}
+
 void join_task(int task) {
     tasks[task]->join();
 }
@@ -73,6 +97,43 @@ void release_sem(int task) {
     tasks[task]->sem().release();
 }
 
+void set_wakeup_spin(int task, int spin) {
+    tasks[task]->set_wakeup_policy(WakeupPolicy{duration(spin)});
+}
+
+void set_budget_policy(int task, double relative_threshold, int absolute_threshold,
+                       int min_interval, int lower_lazily) {
+    tasks[task]->set_budget_policy(BudgetPolicy{relative_threshold, duration(absolute_threshold),
+                                                duration(min_interval), lower_lazily != 0});
+}
+
+void set_completion_callback(int task, void (*complete)(void *)) {
+    tasks[task]->set_completion_callback(complete);
+}
+
+int task_completion_fd(int task) {
+    return tasks[task]->completion_fd();
+}
+
+void link_tasks(int from, int to, void *(*forward)(void *), int max_pending) {
+    tasks[from]->forward_to(tasks[to], CForward{forward}, max_pending);
+}
+
+int wait_for_tasks(void) {
+    duration startup(0);
+    for (CTask *task: tasks) {
+        task->wait_until_ready();
+        startup = std::max(startup, task->startup_time());
+    }
+    return startup / 1us;
+}
+
 int task_period(int task) {
     return tasks[task]->period() / 1ns;
 }
+
+struct runtime_stats task_runtime_stats(int task) {
+    RuntimeStats stats = tasks[task]->runtime_stats();
+    return {stats.count, stats.mean, stats.variance, stats.min, stats.max, stats.p50, stats.p90,
+            stats.p99};
+}
@@ -1,10 +1,24 @@
 #pragma once
 
+/* Metrics of a job. The generator gets data pointing to a buffer owned by the task with size set
+ * to its capacity, writes its metrics to data and sets size to the number it wrote. */
 struct metrics {
     int size;
     double *data;
 };
 
+/* Runtime statistics of a task's jobs so far, in ns. Percentiles are approximate. */
+struct runtime_stats {
+    long count;
+    double mean;
+    double variance;
+    double min;
+    double max;
+    double p50;
+    double p90;
+    double p99;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -13,18 +27,51 @@ int create_non_rt_task(int cpus, int id, void (*execute)(void *));
 
 int create_task(int cpus, int id, int period, void (*execute)(void *), int execution_time);
 
-int create_task_with_prediction(int cpus, int id, int period, void (*execute)(void *), struct metrics(*generate)(void *));
+int create_task_with_prediction(int cpus, int id, int period, void (*execute)(void *), void (*generate)(void *, struct metrics *));
 
 void add_job_to_task(int task, void *arg);
 
+void add_jobs_to_task(int task, void **args, int n);
+
 void join_task(int task);
 
 int task_id(int task);
 
 void release_sem(int task);
 
+void set_wakeup_spin(int task, int spin);
+
+/* Skip runtime updates that change the budget by less than relative_threshold of the current one
+ * or by less than absolute_threshold ns, or that come sooner than min_interval ns after the last one.
+ * With lower_lazily, increases ignore min_interval. Set before the first job is added. */
+void set_budget_policy(int task, double relative_threshold, int absolute_threshold,
+                       int min_interval, int lower_lazily);
+
+/* Completion notification. Both have to be set up before the first job is added to the task. */
+
+/* called on the task thread with the job argument after each job that ran. Skipped jobs do not
+ * count */
+void set_completion_callback(int task, void (*complete)(void *));
+
+/* non-blocking eventfd counting finished jobs, to be used with poll/select/read */
+int task_completion_fd(int task);
+
+/* Pipelines. Connect two tasks as consecutive stages: after each job of from, forward gets called
+ * on from's task thread with the job argument and its result is added as a job to to. A slot of the
+ * next stage is reserved before forward is called, so at most max_pending forwarded jobs are queued
+ * or running at to; from waits while that many are. Returning NULL forwards nothing. to must not get
+ * jobs from anywhere else. Link tasks before the first job is added to either of them. */
+void link_tasks(int from, int to, void *(*forward)(void *), int max_pending);
+
+/* Block until every task created so far has set its affinity and scheduling parameters. Returns
+ * the longest time a task took to get there, in us. */
+int wait_for_tasks(void);
+
 int task_period(int task);
 
+/* can be called from any thread while the task runs */
+struct runtime_stats task_runtime_stats(int task);
+
 #ifdef __cplusplus
 }
 #endif
@@ -185,6 +185,9 @@ class Task:
 
     def print_jobs(self, file: IO) -> None:
         for job in self.jobs.values():
+            # skipped jobs never ran
+            if job.end < 0:
+                continue
             # TODO: calculate n_parts (hardcoded 1 for now)
             print(f"j {job.id} {int((job.end - job.deadline))}", file=file)
 
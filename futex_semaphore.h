@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+/* Counting semaphore for one waiting task thread, built directly on a futex.
+ *
+ * The futex word is the number of available tokens. A waiter registers itself in _waiters before
+ * it goes to sleep, so release only issues FUTEX_WAKE if somebody actually sleeps. Releasing while
+ * the task thread is busy therefore is a single atomic add. */
+class FutexSemaphore {
+    std::atomic<int32_t> _count;
+    std::atomic<int32_t> _waiters = 0;
+
+    static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t));
+
+    int32_t *futex_word() {
+        return reinterpret_cast<int32_t *>(&this->_count);
+    }
+
+    static void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+  public:
+    explicit FutexSemaphore(int32_t value)
+        : _count(value) {}
+
+    FutexSemaphore(const FutexSemaphore &) = delete;
+    FutexSemaphore &operator=(const FutexSemaphore &) = delete;
+
+    bool try_acquire() {
+        /* seq_cst pairs with release: either it sees the token or release sees the waiter */
+        int32_t count = this->_count.load(std::memory_order_seq_cst);
+        while (count > 0) {
+            if (this->_count.compare_exchange_weak(count, count - 1,
+                                                   std::memory_order_acquire,
+                                                   std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* Take one token. Spin for at most spin before going to sleep in the kernel. */
+    void acquire(std::chrono::nanoseconds spin = std::chrono::nanoseconds(0)) {
+        if (this->try_acquire()) {
+            return;
+        }
+
+        if (spin > std::chrono::nanoseconds(0)) {
+            auto spin_end = std::chrono::steady_clock::now() + spin;
+            do {
+                cpu_relax();
+                if (this->try_acquire()) {
+                    return;
+                }
+            } while (std::chrono::steady_clock::now() < spin_end);
+        }
+
+        this->_waiters.fetch_add(1, std::memory_order_seq_cst);
+        while (not this->try_acquire()) {
+            /* sleeps only if there still is no token. Otherwise returns right away */
+            syscall(SYS_futex, this->futex_word(), FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
+        }
+        this->_waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /* Add update tokens. Costs one syscall at most, and none if nobody sleeps. */
+    void release(std::ptrdiff_t update = 1) {
+        this->_count.fetch_add(update, std::memory_order_seq_cst);
+        if (this->_waiters.load(std::memory_order_seq_cst) > 0) {
+            syscall(SYS_futex, this->futex_word(), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr,
+                    0);
+        }
+    }
+};
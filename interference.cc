@@ -0,0 +1,127 @@
+#include "interference.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sched.h>
+
+#include "rt.h"
+
+using namespace std::chrono_literals;
+using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+
+
+/* big enough to miss in the last level cache of the machines we run on */
+static constexpr std::size_t default_thrash_footprint = 64 << 20;
+
+/* busy percent of every window. Short enough that the load looks even to a task's period */
+static constexpr auto interference_window = 1000us;
+/* work between two looks at the clock */
+static constexpr auto interference_chunk = 20us;
+
+bool parse_interference_type(const std::string &name, InterferenceType *type) {
+    if (name == "memory") {
+        *type = InterferenceType::memory;
+    } else if (name == "cache") {
+        *type = InterferenceType::cache;
+    } else if (name == "syscall") {
+        *type = InterferenceType::syscall;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *interference_type_name(InterferenceType type) {
+    switch (type) {
+        break; case InterferenceType::memory:
+            return "memory";
+        break; case InterferenceType::cache:
+            return "cache";
+        break; case InterferenceType::syscall:
+            return "syscall";
+    }
+    return "unknown";
+}
+
+Interference::Interference(const std::vector<InterferenceSpec> &specs) {
+    for (const InterferenceSpec &spec: specs) {
+        for (unsigned cpu: spec.cpus) {
+            auto worker = std::make_unique<Worker>();
+            worker->cpu = cpu;
+            worker->type = spec.type;
+            worker->percent = spec.percent;
+            switch (spec.type) {
+                break; case InterferenceType::memory:
+                    /* the tasks' buffer stays in the caches of their cores, interference
+                     * streams through its own to compete with them for memory bandwidth */
+                    worker->kernel = std::make_unique<Kernel>(
+                                         KernelSpec{KernelType::memory, spec.footprint}, true);
+                break; case InterferenceType::cache:
+                    worker->kernel = std::make_unique<Kernel>(
+                                         KernelSpec{KernelType::cache, spec.footprint
+                                                                       ? spec.footprint
+                                                                       : default_thrash_footprint});
+                break; case InterferenceType::syscall:
+                    /* no kernel */
+                break;
+            }
+            this->_workers.push_back(std::move(worker));
+        }
+    }
+
+    for (auto &worker: this->_workers) {
+        worker->thread = std::thread(&Interference::work, this, worker.get());
+    }
+}
+
+Interference::~Interference() {
+    this->_stop = true;
+    for (auto &worker: this->_workers) {
+        worker->thread.join();
+    }
+}
+
+void Interference::work(Worker *worker) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(worker->cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+        perror("sched_setaffinity");
+        exit(-1);
+    }
+
+    /* threads inherit the spawner's real-time policy, neighbours are normal threads */
+    struct sched_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.sched_policy = SCHED_OTHER;
+    if (sched_setattr(0, &attr, 0) < 0) {
+        perror("sched_setattr");
+        exit(-1);
+    }
+
+    time_point window = std::chrono::steady_clock::now();
+    while (not this->_stop.load(std::memory_order_relaxed)) {
+        time_point busy_end = window + interference_window * worker->percent / 100;
+        while (std::chrono::steady_clock::now() < busy_end) {
+            if (worker->kernel) {
+                worker->kernel->run(interference_chunk);
+            } else {
+                for (int i = 0; i < 16; ++i) {
+                    syscall(SYS_getppid);
+                }
+            }
+        }
+
+        /* a window that is over already, for example because a task preempted the worker, is
+         * not made up for */
+        window += interference_window;
+        time_point now = std::chrono::steady_clock::now();
+        if (window < now) {
+            window = now;
+        } else {
+            std::this_thread::sleep_until(window);
+        }
+    }
+}
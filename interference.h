@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "kernels.h"
+
+
+/* What a background thread does to the real-time tasks next to it */
+enum class InterferenceType {
+    /* streams through memory, competes for memory bandwidth */
+    memory,
+    /* chases pointers through a buffer larger than the last level cache, evicting the tasks' data */
+    cache,
+    /* enters the kernel as often as it can */
+    syscall,
+};
+
+/* returns false for unknown names */
+bool parse_interference_type(const std::string &name, InterferenceType *type);
+const char *interference_type_name(InterferenceType type);
+
+/* one thread of the given type on every one of cpus, busy for percent of every millisecond */
+struct InterferenceSpec {
+    std::vector<unsigned> cpus;
+    InterferenceType type = InterferenceType::memory;
+    int percent = 100;
+    /* buffer size in bytes for memory and cache, 0 for the default */
+    std::size_t footprint = 0;
+};
+
+/* Best-effort neighbours of the real-time tasks. The threads run under the normal scheduler, so
+ * on a cpu of their own they interfere through shared caches and memory only, and next to a task
+ * they get what its reservation leaves. They run from construction until destruction. */
+class Interference {
+    struct Worker {
+        unsigned cpu;
+        InterferenceType type;
+        int percent;
+        std::unique_ptr<Kernel> kernel;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::atomic<bool> _stop = false;
+
+    void work(Worker *worker);
+
+  public:
+    /* kernels are calibrated on the calling thread before the workers start */
+    explicit Interference(const std::vector<InterferenceSpec> &specs);
+    ~Interference();
+
+    Interference(const Interference &) = delete;
+    Interference &operator=(const Interference &) = delete;
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+
+/* Producer and consumer state is kept on separate cache lines, so the spawner and the task thread
+ * do not invalidate each other's lines on every push and pop. */
+constexpr std::size_t cache_line_size = 64;
+
+/* Number of jobs that can be pending per task before add_job has to wait for the task thread. */
+constexpr std::size_t job_queue_capacity = 256;
+
+static inline std::size_t next_power_of_two(std::size_t n) {
+    std::size_t power = 1;
+    while (power < n) {
+        power <<= 1;
+    }
+    return power;
+}
+
+/* Bounded single-producer/single-consumer ring. One thread may push, one (other) thread may pop.
+ * Each side keeps a private copy of the other side's index and only reloads the shared one when the
+ * copy says the ring is full (or empty), so in the common case neither side touches the other's
+ * cache line. */
+template <typename T>
+class SpscRing {
+    const std::size_t _mask;
+    std::unique_ptr<T[]> _slots;
+
+    /* consumer side */
+    alignas(cache_line_size) std::atomic<std::size_t> _head = 0;
+    std::size_t _cached_tail = 0;
+
+    /* producer side */
+    alignas(cache_line_size) std::atomic<std::size_t> _tail = 0;
+    std::size_t _cached_head = 0;
+
+  public:
+    explicit SpscRing(std::size_t capacity = job_queue_capacity)
+        : _mask(next_power_of_two(capacity) - 1),
+          _slots(new T[this->_mask + 1]) {}
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    /* producer only. Returns false if the ring is full */
+    bool try_push(const T &value) {
+        std::size_t tail = this->_tail.load(std::memory_order_relaxed);
+        if (tail - this->_cached_head > this->_mask) {
+            this->_cached_head = this->_head.load(std::memory_order_acquire);
+            if (tail - this->_cached_head > this->_mask) {
+                return false;
+            }
+        }
+        this->_slots[tail & this->_mask] = value;
+        this->_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* consumer only. Returns false if the ring is empty */
+    bool try_pop(T *value) {
+        std::size_t head = this->_head.load(std::memory_order_relaxed);
+        if (head == this->_cached_tail) {
+            this->_cached_tail = this->_tail.load(std::memory_order_acquire);
+            if (head == this->_cached_tail) {
+                return false;
+            }
+        }
+        *value = std::move(this->_slots[head & this->_mask]);
+        this->_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* exact when called by the consumer, a snapshot otherwise */
+    bool empty() const {
+        return this->_head.load(std::memory_order_relaxed)
+               == this->_tail.load(std::memory_order_acquire);
+    }
+
+    std::size_t capacity() const {
+        return this->_mask + 1;
+    }
+};
+
+/* Bounded multi-producer/single-consumer ring. Producers claim a slot by advancing the tail and
+ * publish it through the slot's sequence number, so any number of threads may push concurrently
+ * while one thread pops. */
+template <typename T>
+class MpscRing {
+    struct alignas(cache_line_size) Slot {
+        std::atomic<std::size_t> _sequence;
+        T _value;
+    };
+
+    const std::size_t _mask;
+    std::unique_ptr<Slot[]> _slots;
+
+    /* consumer side */
+    alignas(cache_line_size) std::size_t _head = 0;
+
+    /* producer side */
+    alignas(cache_line_size) std::atomic<std::size_t> _tail = 0;
+
+  public:
+    explicit MpscRing(std::size_t capacity = job_queue_capacity)
+        : _mask(next_power_of_two(capacity) - 1),
+          _slots(new Slot[this->_mask + 1]) {
+        for (std::size_t i = 0; i <= this->_mask; ++i) {
+            this->_slots[i]._sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing &) = delete;
+    MpscRing &operator=(const MpscRing &) = delete;
+
+    /* any thread. Returns false if the ring is full */
+    bool try_push(const T &value) {
+        std::size_t tail = this->_tail.load(std::memory_order_relaxed);
+        while (true) {
+            Slot &slot = this->_slots[tail & this->_mask];
+            std::size_t sequence = slot._sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence - tail);
+            if (diff == 0) {
+                if (this->_tail.compare_exchange_weak(tail, tail + 1,
+                                                      std::memory_order_relaxed)) {
+                    slot._value = value;
+                    slot._sequence.store(tail + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                tail = this->_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /* consumer only. Returns false if the ring is empty */
+    bool try_pop(T *value) {
+        Slot &slot = this->_slots[this->_head & this->_mask];
+        if (slot._sequence.load(std::memory_order_acquire) != this->_head + 1) {
+            return false;
+        }
+        *value = std::move(slot._value);
+        slot._sequence.store(this->_head + this->_mask + 1, std::memory_order_release);
+        ++this->_head;
+        return true;
+    }
+
+    /* consumer only */
+    bool empty() const {
+        const Slot &slot = this->_slots[this->_head & this->_mask];
+        return slot._sequence.load(std::memory_order_acquire) != this->_head + 1;
+    }
+
+    std::size_t capacity() const {
+        return this->_mask + 1;
+    }
+};
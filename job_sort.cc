@@ -0,0 +1,167 @@
+#include "job_sort.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+
+/* spawn order */
+static bool job_before(const Job &a, const Job &b) {
+    return std::tie(a._submission_time, a._task, a._id)
+           < std::tie(b._submission_time, b._task, b._id);
+}
+
+/* run work(i) for i in [0, n) on n threads */
+template <typename Work>
+static void parallel(unsigned n, Work work) {
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < n; ++i) {
+        threads.emplace_back(work, i);
+    }
+    work(0);
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+}
+
+void number_and_sort_jobs(std::vector<Job> *jobs, const std::vector<TaskLoad> &tasks,
+                          unsigned n_threads) {
+    n_threads = std::max(n_threads, 1u);
+    std::size_t n_jobs = jobs->size();
+    if (n_jobs == 0) {
+        return;
+    }
+    std::size_t n_tasks = tasks.size();
+
+    /* the merge costs more than a plain sort on one thread */
+    if (n_threads == 1) {
+        std::vector<JobNumbering> numbering(n_tasks);
+        for (Job &job: *jobs) {
+            numbering[job._task].number(tasks[job._task], &job);
+        }
+        std::sort(jobs->begin(), jobs->end(), job_before);
+        return;
+    }
+
+    auto chunk = [&](unsigned thread) {
+        return std::pair<std::size_t, std::size_t>(n_jobs * thread / n_threads,
+                                                   n_jobs * (thread + 1) / n_threads);
+    };
+
+    /* 1. count the jobs of every task in every thread's chunk. A task's run takes the jobs of
+     * chunk 0 first, then chunk 1 and so on, which keeps the input order */
+    std::vector<std::vector<std::size_t>> counts(n_threads, std::vector<std::size_t>(n_tasks));
+    parallel(n_threads, [&](unsigned thread) {
+        auto [begin, end] = chunk(thread);
+        for (std::size_t i = begin; i < end; ++i) {
+            ++counts[thread][(*jobs)[i]._task];
+        }
+    });
+
+    /* run of task t is [run_begin[t], run_begin[t + 1]). counts become the index within the run
+     * each thread's first job of the task goes to */
+    std::vector<std::size_t> run_begin(n_tasks + 1);
+    for (std::size_t task = 0; task < n_tasks; ++task) {
+        std::size_t n_task_jobs = 0;
+        for (unsigned thread = 0; thread < n_threads; ++thread) {
+            std::size_t count = counts[thread][task];
+            counts[thread][task] = n_task_jobs;
+            n_task_jobs += count;
+        }
+        run_begin[task + 1] = run_begin[task] + n_task_jobs;
+    }
+
+    std::vector<Job> runs(n_jobs);
+    parallel(n_threads, [&](unsigned thread) {
+        auto [begin, end] = chunk(thread);
+        std::vector<std::size_t> &next = counts[thread];
+        for (std::size_t i = begin; i < end; ++i) {
+            const Job &job = (*jobs)[i];
+            runs[run_begin[job._task] + next[job._task]++] = job;
+        }
+    });
+
+    /* 2. number every run in input order, as a job's release can depend on the one before. Runs
+     * are usually sorted then already, as jobs of a task come in submission order */
+    std::atomic<std::size_t> next_task = 0;
+    parallel(n_threads, [&](unsigned) {
+        for (std::size_t task = next_task++; task < n_tasks; task = next_task++) {
+            auto begin = runs.begin() + run_begin[task];
+            auto end = runs.begin() + run_begin[task + 1];
+            JobNumbering numbering;
+            for (auto job = begin; job != end; ++job) {
+                numbering.number(tasks[task], &*job);
+            }
+            if (not std::is_sorted(begin, end, job_before)) {
+                std::sort(begin, end, job_before);
+            }
+        }
+    });
+
+    /* 3. splitters: every thread gets about the same number of jobs if the samples are spread
+     * like the jobs. Each thread then merges the part of every run between its splitters */
+    std::vector<Job> samples;
+    std::size_t sample_step = std::max<std::size_t>(n_jobs / (n_threads * 64), 1);
+    for (std::size_t i = 0; i < n_jobs; i += sample_step) {
+        samples.push_back(runs[i]);
+    }
+    std::sort(samples.begin(), samples.end(), job_before);
+
+    /* bounds[p][t]: where part p starts in the run of task t */
+    std::vector<std::vector<std::size_t>> bounds(n_threads + 1,
+                                                 std::vector<std::size_t>(n_tasks));
+    for (std::size_t task = 0; task < n_tasks; ++task) {
+        bounds[0][task] = run_begin[task];
+        bounds[n_threads][task] = run_begin[task + 1];
+    }
+    parallel(n_threads, [&](unsigned part) {
+        if (part == 0) {
+            return;
+        }
+        const Job &splitter = samples[samples.size() * part / n_threads];
+        for (std::size_t task = 0; task < n_tasks; ++task) {
+            bounds[part][task] = std::lower_bound(runs.begin() + run_begin[task],
+                                                  runs.begin() + run_begin[task + 1], splitter,
+                                                  job_before) - runs.begin();
+        }
+    });
+
+    parallel(n_threads, [&](unsigned part) {
+        std::size_t out = 0;
+        for (std::size_t task = 0; task < n_tasks; ++task) {
+            out += bounds[part][task] - run_begin[task];
+        }
+
+        /* next job of every run in this part, earliest first. The heads carry a copy of their
+         * job so comparing them does not go back to the runs */
+        struct Head {
+            Job job;
+            std::size_t next;
+            std::size_t end;
+        };
+        auto later = [](const Head &a, const Head &b) {
+            return job_before(b.job, a.job);
+        };
+        std::vector<Head> heads;
+        for (std::size_t task = 0; task < n_tasks; ++task) {
+            if (bounds[part][task] < bounds[part + 1][task]) {
+                heads.push_back(Head{runs[bounds[part][task]], bounds[part][task] + 1,
+                                     bounds[part + 1][task]});
+            }
+        }
+        std::make_heap(heads.begin(), heads.end(), later);
+        while (not heads.empty()) {
+            std::pop_heap(heads.begin(), heads.end(), later);
+            Head &head = heads.back();
+            (*jobs)[out++] = head.job;
+            if (head.next < head.end) {
+                head.job = runs[head.next++];
+                std::push_heap(heads.begin(), heads.end(), later);
+            } else {
+                heads.pop_back();
+            }
+        }
+    });
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "partition.h"
+#include "sim_input.h"
+
+
+/* inputs from this size on are worth the threads */
+constexpr std::size_t parallel_sort_threshold = 1 << 20;
+
+/* Number the jobs of every task in input order, give them their deadlines (see JobNumbering) and
+ * sort them into spawn order, by submission time, task and id. The same as numbering them one by
+ * one and sorting afterwards, but on n_threads threads:
+ *
+ *   1. the jobs are scattered into one run per task, which keeps their order
+ *   2. every run is numbered and, if it is not sorted by submission time then, sorted
+ *   3. the runs are merged k-way, every thread merging the jobs between two splitters
+ *
+ * On one thread it numbers and sorts plainly. The threads inherit the caller's cpu affinity. */
+void number_and_sort_jobs(std::vector<Job> *jobs, const std::vector<TaskLoad> &tasks,
+                          unsigned n_threads);
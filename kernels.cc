@@ -0,0 +1,197 @@
+#include "kernels.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <utility>
+
+#include "task.h"
+
+using namespace std::chrono_literals;
+
+
+static constexpr std::size_t default_memory_footprint = 64 << 20;
+static constexpr std::size_t default_cache_footprint = 1 << 20;
+
+bool parse_kernel_type(const std::string &name, KernelType *type) {
+    if (name == "spin") {
+        *type = KernelType::spin;
+    } else if (name == "alu") {
+        *type = KernelType::alu;
+    } else if (name == "memory") {
+        *type = KernelType::memory;
+    } else if (name == "cache") {
+        *type = KernelType::cache;
+    } else if (name == "branchy") {
+        *type = KernelType::branchy;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *kernel_type_name(KernelType type) {
+    switch (type) {
+        break; case KernelType::spin:
+            return "spin";
+        break; case KernelType::alu:
+            return "alu";
+        break; case KernelType::memory:
+            return "memory";
+        break; case KernelType::cache:
+            return "cache";
+        break; case KernelType::branchy:
+            return "branchy";
+    }
+    return "unknown";
+}
+
+/* units per ns by spec, measured by the first kernel of each spec */
+static std::map<KernelSpec, double> calibrations;
+
+/* median of a few measurements. Each runs long enough that clock resolution and a stray
+ * interrupt do not matter much */
+double Kernel::calibrate() {
+    this->run_units(1024);
+    std::vector<double> rates;
+    for (int trial = 0; trial < 5; ++trial) {
+        for (uint64_t n = 1024;; n *= 2) {
+            time_point begin = thread_now();
+            this->run_units(n);
+            duration elapsed = thread_now() - begin;
+            if (elapsed >= 5ms) {
+                rates.push_back(static_cast<double>(n) / elapsed.count());
+                break;
+            }
+        }
+    }
+    std::nth_element(rates.begin(), rates.begin() + rates.size() / 2, rates.end());
+    return rates[rates.size() / 2];
+}
+
+std::shared_ptr<const std::vector<Kernel::Line>> Kernel::streaming_buffer(std::size_t n_lines) {
+    /* by size, alive as long as a kernel uses them */
+    static std::map<std::size_t, std::weak_ptr<const std::vector<Line>>> buffers;
+    std::weak_ptr<const std::vector<Line>> &buffer = buffers[n_lines];
+    std::shared_ptr<const std::vector<Line>> lines = buffer.lock();
+    if (not lines) {
+        lines = std::make_shared<const std::vector<Line>>(n_lines);
+        buffer = lines;
+    }
+    return lines;
+}
+
+Kernel::Kernel(KernelSpec spec, bool own_buffer)
+    : _spec(spec) {
+    std::size_t footprint = this->_spec.footprint;
+    switch (this->_spec.type) {
+        break; case KernelType::spin:
+            return;
+        break; case KernelType::memory:
+            footprint = footprint ? footprint : default_memory_footprint;
+        break; case KernelType::cache:
+            footprint = footprint ? footprint : default_cache_footprint;
+        break; case KernelType::alu:
+            /* no memory */
+        break; case KernelType::branchy:
+            /* no memory */
+        break;
+    }
+
+    std::size_t n_lines = std::max<std::size_t>(footprint / sizeof(Line), 1);
+    if (footprint and this->_spec.type == KernelType::memory and not own_buffer) {
+        this->_lines = streaming_buffer(n_lines);
+    } else if (footprint and this->_spec.type == KernelType::memory) {
+        this->_lines = std::make_shared<const std::vector<Line>>(n_lines);
+    } else if (footprint) {
+        auto lines = std::make_shared<std::vector<Line>>(n_lines);
+        for (std::size_t i = 0; i < lines->size(); ++i) {
+            (*lines)[i].next = (i + 1) % lines->size();
+        }
+        /* Sattolo's algorithm: a random permutation that is a single cycle, so the chase visits
+         * every line before it repeats and the prefetcher cannot guess the next one */
+        std::mt19937_64 random(lines->size());
+        for (std::size_t i = lines->size() - 1; i > 0; --i) {
+            std::size_t j = std::uniform_int_distribution<std::size_t>(0, i - 1)(random);
+            std::swap((*lines)[i].next, (*lines)[j].next);
+        }
+        this->_lines = std::move(lines);
+    }
+
+    auto calibration = calibrations.find(this->_spec);
+    if (calibration == calibrations.end()) {
+        calibration = calibrations.emplace(this->_spec, this->calibrate()).first;
+    }
+    this->_units_per_ns = calibration->second;
+}
+
+void Kernel::run_units(uint64_t n) {
+    uint64_t x = this->_state;
+    uint64_t sum = 0;
+    switch (this->_spec.type) {
+        break; case KernelType::spin:
+        break; case KernelType::alu:
+            for (uint64_t i = 0; i < n; ++i) {
+                for (int j = 0; j < 32; ++j) {
+                    x = x * 6364136223846793005 + 1442695040888963407;
+                    x ^= x >> 29;
+                }
+            }
+        break; case KernelType::memory: {
+            const std::vector<Line> &lines = *this->_lines;
+            std::size_t position = this->_position;
+            for (uint64_t i = 0; i < n; ++i) {
+                sum += lines[position].data[0];
+                if (++position == lines.size()) {
+                    position = 0;
+                }
+            }
+            this->_position = position;
+        }
+        break; case KernelType::cache: {
+            const std::vector<Line> &lines = *this->_lines;
+            std::size_t position = this->_position;
+            for (uint64_t i = 0; i < n; ++i) {
+                position = lines[position].next;
+                sum += lines[position].data[0];
+            }
+            this->_position = position;
+        }
+        break; case KernelType::branchy:
+            for (uint64_t i = 0; i < n; ++i) {
+                for (int j = 0; j < 16; ++j) {
+                    x ^= x << 13;
+                    x ^= x >> 7;
+                    x ^= x << 17;
+                    if (x & 1) {
+                        sum += x >> 32;
+                    } else {
+                        sum ^= x;
+                    }
+                    switch (x >> 62) {
+                        break; case 0:
+                            sum += 3;
+                        break; case 1:
+                            sum *= 5;
+                        break; case 2:
+                            sum -= x & 0xff;
+                        break; default:
+                            sum = ~sum;
+                    }
+                }
+            }
+    }
+    this->_state = x;
+    this->_sink = this->_sink + sum;
+}
+
+void Kernel::run(std::chrono::nanoseconds execution_time) {
+    if (this->_spec.type == KernelType::spin) {
+        time_point thread_end = thread_now() + execution_time;
+        while (thread_now() < thread_end) {
+            /* spin */
+        }
+        return;
+    }
+    this->run_units(execution_time.count() * this->_units_per_ns);
+}
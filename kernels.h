@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/* What a simulated job does while it runs */
+enum class KernelType {
+    /* polls the thread's cpu clock until the execution time is used up. Exact, but the work is
+     * mostly system calls */
+    spin,
+    /* dependent integer arithmetic, stays in registers */
+    alu,
+    /* streams through a buffer larger than the caches */
+    memory,
+    /* chases pointers in random order through a buffer of the given footprint */
+    cache,
+    /* data dependent branches the predictor cannot learn */
+    branchy,
+};
+
+struct KernelSpec {
+    KernelType type = KernelType::spin;
+    /* buffer size in bytes for memory and cache, 0 for the default */
+    std::size_t footprint = 0;
+
+    auto operator<=>(const KernelSpec &) const = default;
+};
+
+/* returns false for unknown names */
+bool parse_kernel_type(const std::string &name, KernelType *type);
+const char *kernel_type_name(KernelType type);
+
+/* Synthetic work of one kind, calibrated to take a given amount of cpu time.
+ *
+ * The kernels work in units whose cost is measured on construction, so running one does not touch
+ * the clock. Calibration results are shared between kernels of the same spec, so constructing
+ * many kernels is cheap but has to happen on one thread, and on a cpu like the ones the kernels
+ * run on later. Memory kernels only read their buffer, so kernels with the same footprint stream
+ * through one shared buffer unless they ask for their own. Cache kernels always own theirs, as
+ * their footprint is what they measure.
+ * Every kernel must only be run by one thread. */
+class Kernel {
+    KernelSpec _spec;
+    double _units_per_ns = 0;
+
+    /* cache lines, chained into one random cycle for the cache kernel */
+    struct alignas(64) Line {
+        uint64_t next;
+        uint64_t data[7];
+    };
+    /* the kernel's own for cache kernels, shared between memory kernels by default */
+    std::shared_ptr<const std::vector<Line>> _lines;
+    std::size_t _position = 0;
+    uint64_t _state = 0x9e3779b97f4a7c15;
+    /* results end up here so the compiler cannot drop the work */
+    volatile uint64_t _sink = 0;
+
+    /* the read-only buffer of memory kernels with n_lines lines */
+    static std::shared_ptr<const std::vector<Line>> streaming_buffer(std::size_t n_lines);
+
+    void run_units(uint64_t n);
+
+    /* units per ns */
+    double calibrate();
+
+  public:
+    /* own_buffer keeps a memory kernel off the shared buffer, so its traffic adds to that of the
+     * other kernels instead of hitting the same lines */
+    explicit Kernel(KernelSpec spec, bool own_buffer = false);
+
+    /* keep the cpu busy for about execution_time of thread cpu time */
+    void run(std::chrono::nanoseconds execution_time);
+
+    const KernelSpec &spec() const {
+        return this->_spec;
+    }
+};
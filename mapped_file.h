@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* read-only mapping of a whole file */
+class MappedFile {
+    const char *_data = nullptr;
+    std::size_t _size = 0;
+    /* pages before this were handed back with release_until */
+    const char *_released = nullptr;
+
+  public:
+    /* populate reads the whole file in right away. Without it pages are read as they are touched,
+     * which suits files that are consumed front to back while the program runs */
+    explicit MappedFile(const std::string &path, bool populate = true) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "Could not open file: " << path << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            perror("fstat");
+            exit(-1);
+        }
+        this->_size = st.st_size;
+        if (this->_size > 0) {
+            int flags = MAP_PRIVATE | (populate ? MAP_POPULATE : 0);
+            void *data = mmap(nullptr, this->_size, PROT_READ, flags, fd, 0);
+            if (data == MAP_FAILED) {
+                perror("mmap");
+                exit(-1);
+            }
+            madvise(data, this->_size, MADV_SEQUENTIAL);
+            this->_data = static_cast<const char *>(data);
+            this->_released = this->_data;
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (this->_data) {
+            munmap(const_cast<char *>(this->_data), this->_size);
+        }
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *begin() const {
+        return this->_data;
+    }
+
+    const char *end() const {
+        return this->_data + this->_size;
+    }
+
+    std::size_t size() const {
+        return this->_size;
+    }
+
+    /* drop the pages wholly before pos from memory. They are read again if touched */
+    void release_until(const char *pos) {
+        static const std::size_t page_size = sysconf(_SC_PAGESIZE);
+        std::size_t offset = (pos - this->_data) / page_size * page_size;
+        const char *until = this->_data + offset;
+        if (until > this->_released) {
+            madvise(const_cast<char *>(this->_released), until - this->_released, MADV_DONTNEED);
+            this->_released = until;
+        }
+    }
+};
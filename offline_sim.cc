@@ -0,0 +1,242 @@
+#include "offline_sim.h"
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <tuple>
+
+
+/* smallest runtime the kernel accepts for SCHED_DEADLINE */
+static constexpr int64_t min_runtime = 1024;
+
+/* one task's SCHED_DEADLINE server */
+struct Server {
+    int id;
+    unsigned cpu;
+    int64_t period;
+    /* sched_deadline, at most the period */
+    int64_t relative_deadline;
+    /* sched_runtime as configured, used for every replenishment */
+    int64_t runtime;
+    /* remaining budget and absolute deadline of the current server period */
+    int64_t budget = 0;
+    int64_t deadline = 0;
+    bool throttled = false;
+
+    std::deque<std::size_t> pending;
+    /* job being worked on, or -1 */
+    long current = -1;
+    int64_t work = 0;
+    bool degraded = false;
+    long n_started = 0;
+
+    atlas::estimator predictor;
+
+    bool ready() const {
+        return this->current >= 0 and not this->throttled;
+    }
+
+    bool idle() const {
+        return this->current < 0 and this->pending.empty();
+    }
+
+    /* when a throttled server gets its budget back. The deadline itself for implicit deadlines */
+    int64_t next_period() const {
+        return this->deadline - this->relative_deadline + this->period;
+    }
+};
+
+/* CBS wakeup rule: start a new server period if the old one cannot be continued without exceeding
+ * the reserved bandwidth. Like the kernel's, the test is against runtime over relative deadline */
+static void wake_up(Server *server, int64_t now) {
+    double remaining = static_cast<double>(server->budget) * server->relative_deadline;
+    double allowed = static_cast<double>(server->deadline - now) * server->runtime;
+    if (server->deadline <= now or remaining > allowed) {
+        server->deadline = now + server->relative_deadline;
+        server->budget = server->runtime;
+    }
+}
+
+static void replenish(Server *server, int64_t now) {
+    while (server->budget <= 0) {
+        server->deadline += server->period;
+        server->budget += server->runtime;
+    }
+    if (server->deadline < now) {
+        server->deadline = now + server->relative_deadline;
+        server->budget = server->runtime;
+    }
+    server->throttled = false;
+}
+
+/* take the server's next job according to the job order and late policy */
+static void start_next_job(Server *server, int64_t now, const std::vector<OfflineJob> &jobs,
+                           const OfflineConfig &config, std::vector<OfflineResult> *results) {
+    while (server->current < 0 and not server->pending.empty()) {
+        auto next = server->pending.begin();
+        if (config.job_order == JobOrder::edf) {
+            next = std::min_element(server->pending.begin(), server->pending.end(),
+                                    [&jobs](std::size_t a, std::size_t b) {
+                                        return std::tie(jobs[a].deadline, a)
+                                               < std::tie(jobs[b].deadline, b);
+                                    });
+        }
+        std::size_t index = *next;
+        server->pending.erase(next);
+        const OfflineJob &job = jobs[index];
+
+        bool late = config.late_policy != LatePolicy::run and now > job.deadline;
+        if (late and config.late_policy == LatePolicy::skip) {
+            (*results)[index] = OfflineResult{job.task_id, job.id, 0, true};
+            continue;
+        }
+        /* like TaskBase's runtime count, skipped jobs do not count */
+        long n_started = server->n_started++;
+
+        server->current = index;
+        server->degraded = late;
+        server->work = late ? static_cast<int64_t>(job.execution_time * config.degrade_factor)
+                            : job.execution_time;
+
+        /* the first job runs with the initial 90% of the deadline, see Task::run_job. Predictions
+         * are made and trained under the job's id, as sched_sim's tasks do */
+        if (config.prediction_enabled and n_started > 0) {
+            double metrics[1] = {0};
+            std::chrono::nanoseconds prediction =
+                server->predictor.predict(0, job.id, metrics, 0);
+            int64_t reserved = prediction.count() * (1 + config.headroom);
+            server->runtime = std::clamp<int64_t>(reserved, min_runtime,
+                                                  server->relative_deadline);
+        }
+    }
+}
+
+static void finish_job(Server *server, int64_t now, const std::vector<OfflineJob> &jobs,
+                       const OfflineConfig &config, std::vector<OfflineResult> *results) {
+    const OfflineJob &job = jobs[server->current];
+    (*results)[server->current] = OfflineResult{job.task_id, job.id, now - job.deadline, false};
+    if (config.prediction_enabled and not server->degraded) {
+        server->predictor.train(0, job.id, std::chrono::nanoseconds(job.execution_time));
+    }
+    server->current = -1;
+}
+
+/* servers that get a CPU until the next event */
+static void pick_running(const std::vector<std::unique_ptr<Server>> &servers,
+                         const OfflineConfig &config, unsigned n_cores,
+                         std::vector<Server *> *running) {
+    auto earlier = [](const Server *a, const Server *b) {
+        return std::tie(a->deadline, a->id) < std::tie(b->deadline, b->id);
+    };
+
+    running->clear();
+    if (config.global) {
+        for (const auto &server: servers) {
+            if (server->ready()) {
+                running->push_back(server.get());
+            }
+        }
+        std::size_t n = std::min<std::size_t>(config.n_cpus, running->size());
+        std::partial_sort(running->begin(), running->begin() + n, running->end(), earlier);
+        running->resize(n);
+        return;
+    }
+
+    std::vector<Server *> per_core(n_cores, nullptr);
+    for (const auto &server: servers) {
+        Server *&best = per_core[server->cpu];
+        if (server->ready() and (not best or earlier(server.get(), best))) {
+            best = server.get();
+        }
+    }
+    for (Server *server: per_core) {
+        if (server) {
+            running->push_back(server);
+        }
+    }
+}
+
+std::vector<OfflineResult> simulate_offline(const std::vector<TaskLoad> &tasks,
+                                            const Partition &partition,
+                                            const std::vector<OfflineJob> &jobs,
+                                            const OfflineConfig &config) {
+    std::vector<std::unique_ptr<Server>> servers;
+    std::map<int, Server *> by_id;
+    for (const TaskLoad &task: tasks) {
+        auto server = std::make_unique<Server>();
+        server->id = task.id;
+        server->cpu = config.global ? 0 : partition.cores.at(task.id);
+        server->period = task.period.count();
+        server->relative_deadline = task.relative_deadline().count();
+        /* what TaskBase configures for the constructor sched_sim picks */
+        server->runtime = std::max<int64_t>(task.initial_runtime(config.prediction_enabled).count(),
+                                            min_runtime);
+        by_id[task.id] = server.get();
+        servers.push_back(std::move(server));
+    }
+    unsigned n_cores = std::max<std::size_t>(partition.utilization.size(), 1);
+
+    std::vector<std::size_t> arrivals(jobs.size());
+    std::iota(arrivals.begin(), arrivals.end(), 0);
+    std::stable_sort(arrivals.begin(), arrivals.end(), [&jobs](std::size_t a, std::size_t b) {
+        return jobs[a].submission_time < jobs[b].submission_time;
+    });
+
+    std::vector<OfflineResult> results(jobs.size());
+    std::vector<Server *> running;
+    std::size_t next_arrival = 0;
+    int64_t now = 0;
+    while (true) {
+        for (; next_arrival < arrivals.size()
+               and jobs[arrivals[next_arrival]].submission_time <= now; ++next_arrival) {
+            std::size_t index = arrivals[next_arrival];
+            Server *server = by_id.at(jobs[index].task_id);
+            if (server->idle() and not server->throttled) {
+                wake_up(server, now);
+            }
+            server->pending.push_back(index);
+        }
+        for (auto &server: servers) {
+            if (server->throttled and server->next_period() <= now) {
+                replenish(server.get(), now);
+            }
+            start_next_job(server.get(), now, jobs, config, &results);
+        }
+
+        pick_running(servers, config, n_cores, &running);
+
+        int64_t next = std::numeric_limits<int64_t>::max();
+        if (next_arrival < arrivals.size()) {
+            next = jobs[arrivals[next_arrival]].submission_time;
+        }
+        for (auto &server: servers) {
+            if (server->throttled) {
+                next = std::min(next, server->next_period());
+            }
+        }
+        for (Server *server: running) {
+            int64_t until_blocked = std::min(server->work, std::max<int64_t>(server->budget, 0));
+            next = std::min(next, now + until_blocked);
+        }
+        if (next == std::numeric_limits<int64_t>::max()) {
+            break;
+        }
+
+        int64_t elapsed = next - now;
+        now = next;
+        for (Server *server: running) {
+            server->work -= elapsed;
+            server->budget -= elapsed;
+            if (server->work <= 0) {
+                finish_job(server, now, jobs, config, &results);
+            }
+            if (server->budget <= 0) {
+                server->throttled = true;
+            }
+        }
+    }
+
+    return results;
+}
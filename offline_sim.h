@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "partition.h"
+#include "task.h"
+
+
+/* A job as the offline simulator sees it. All times in ns since the start of the simulation. */
+struct OfflineJob {
+    int task_id;
+    int id;
+    int64_t submission_time;
+    int64_t execution_time;
+    int64_t deadline;
+};
+
+struct OfflineConfig {
+    /* all tasks share n_cpus under global EDF, otherwise they stay on their partition's core */
+    bool global = false;
+    unsigned n_cpus = 1;
+    bool prediction_enabled = false;
+    /* as BudgetPolicy::headroom */
+    double headroom = 0;
+    JobOrder job_order = JobOrder::fifo;
+    LatePolicy late_policy = LatePolicy::run;
+    double degrade_factor = 0.5;
+};
+
+/* what happened to one job */
+struct OfflineResult {
+    int task_id;
+    int id;
+    /* end - deadline in ns, like eval.py reports it */
+    int64_t lateness;
+    bool skipped;
+};
+
+/* Discrete-event simulation of the tasks' SCHED_DEADLINE servers in virtual time.
+ *
+ * Every task is a constant bandwidth server with the deadline and period TaskBase would configure.
+ * It starts with TaskLoad::initial_runtime, the declared execution time without prediction and
+ * 90% of the relative deadline with it. A waking server keeps its budget and deadline unless that
+ * would exceed its bandwidth (the CBS wakeup rule). A server that runs out of budget is throttled
+ * until its next period and then replenished with the deadline moved by one period. Every CPU runs
+ * its ready server with the earliest deadline, or the n_cpus earliest ones share all CPUs in global
+ * mode. With prediction the predictor sets the runtime before each job, as on the real system.
+ *
+ * Runs without privileges and independent of the machine, so traces replay as fast as the event
+ * count allows. Results are in job submission order. */
+std::vector<OfflineResult> simulate_offline(const std::vector<TaskLoad> &tasks,
+                                            const Partition &partition,
+                                            const std::vector<OfflineJob> &jobs,
+                                            const OfflineConfig &config);
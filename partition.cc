@@ -0,0 +1,119 @@
+#include "partition.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include <sched.h>
+
+
+bool parse_fit_heuristic(const std::string &name, FitHeuristic *heuristic) {
+    if (name == "first-fit") {
+        *heuristic = FitHeuristic::first_fit;
+    } else if (name == "worst-fit") {
+        *heuristic = FitHeuristic::worst_fit;
+    } else if (name == "best-fit") {
+        *heuristic = FitHeuristic::best_fit;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* index of the core the heuristic picks for a task with utilization u, or -1 if none fits */
+static int pick_core(const std::vector<double> &load, double u, FitHeuristic heuristic,
+                     double capacity) {
+    int chosen = -1;
+    for (int core = 0; core < static_cast<int>(load.size()); ++core) {
+        /* tolerate rounding, e.g. 0.7 + 0.2 + 0.1 */
+        if (load[core] + u > capacity + 1e-9) {
+            continue;
+        }
+        switch (heuristic) {
+            break; case FitHeuristic::first_fit:
+                return core;
+            break; case FitHeuristic::worst_fit:
+                if (chosen < 0 or load[core] < load[chosen]) {
+                    chosen = core;
+                }
+            break; case FitHeuristic::best_fit:
+                if (chosen < 0 or load[core] > load[chosen]) {
+                    chosen = core;
+                }
+        }
+    }
+    return chosen;
+}
+
+Partition partition_tasks(std::vector<TaskLoad> tasks, unsigned n_cores, FitHeuristic heuristic,
+                          double capacity) {
+    Partition partition;
+    partition.utilization.assign(std::max(n_cores, 1u), 0);
+
+    /* decreasing density, ties by id to keep the result reproducible */
+    std::sort(tasks.begin(), tasks.end(), [](const TaskLoad &a, const TaskLoad &b) {
+        if (a.density() != b.density()) {
+            return a.density() > b.density();
+        }
+        return a.id < b.id;
+    });
+
+    for (const TaskLoad &task: tasks) {
+        double u = task.density();
+        int core = pick_core(partition.utilization, u, heuristic, capacity);
+        if (core < 0) {
+            partition.feasible = false;
+            core = std::min_element(partition.utilization.begin(), partition.utilization.end())
+                   - partition.utilization.begin();
+        }
+        partition.cores[task.id] = core;
+        partition.utilization[core] += u;
+    }
+
+    return partition;
+}
+
+std::vector<unsigned> cpuset_cpus() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+        perror("sched_getaffinity");
+        exit(-1);
+    }
+
+    std::vector<unsigned> cpus;
+    for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+static long read_proc_value(const char *path) {
+    std::ifstream file(path);
+    long value;
+    if (not (file >> value)) {
+        std::cerr << "Could not read " << path << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return value;
+}
+
+GlobalAdmission admit_global(const std::vector<TaskLoad> &tasks, unsigned n_cpus,
+                             bool prediction_enabled) {
+    GlobalAdmission admission;
+    for (const TaskLoad &task: tasks) {
+        admission.utilization += task.initial_bandwidth(prediction_enabled);
+    }
+
+    long rt_runtime = read_proc_value("/proc/sys/kernel/sched_rt_runtime_us");
+    long rt_period = read_proc_value("/proc/sys/kernel/sched_rt_period_us");
+    /* -1 disables throttling and with it the bandwidth limit */
+    double per_cpu = rt_runtime < 0 ? 1 : static_cast<double>(rt_runtime) / rt_period;
+    admission.limit = n_cpus * per_cpu;
+    admission.admitted = admission.utilization <= admission.limit;
+    return admission;
+}
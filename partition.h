@@ -0,0 +1,103 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+
+/* what the partitioner needs to know about a task */
+struct TaskLoad {
+    int id;
+    std::chrono::nanoseconds execution_time;
+    std::chrono::nanoseconds period;
+    /* time from a job's release to its deadline, the period if zero */
+    std::chrono::nanoseconds deadline = std::chrono::nanoseconds(0);
+    /* sporadic tasks: least time between two releases. Zero releases every job when it is
+     * submitted */
+    std::chrono::nanoseconds min_interarrival = std::chrono::nanoseconds(0);
+
+    std::chrono::nanoseconds relative_deadline() const {
+        return this->deadline.count() ? this->deadline : this->period;
+    }
+
+    double utilization() const {
+        return this->period.count() ? static_cast<double>(this->execution_time.count())
+                                      / this->period.count()
+                                    : 0;
+    }
+
+    /* The runtime the task's SCHED_DEADLINE reservation starts with. As in TaskBase::run_task,
+     * that is the declared execution time, or 90% of the relative deadline with prediction or
+     * without a declared execution time */
+    std::chrono::nanoseconds initial_runtime(bool prediction_enabled) const {
+        if (prediction_enabled or this->execution_time <= std::chrono::microseconds(1)) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       0.9 * this->relative_deadline());
+        }
+        return this->execution_time;
+    }
+
+    /* share of a cpu the reservation asks for when the task's thread starts */
+    double initial_bandwidth(bool prediction_enabled) const {
+        return this->period.count()
+               ? static_cast<double>(this->initial_runtime(prediction_enabled).count())
+                 / this->period.count()
+               : 0;
+    }
+
+    /* utilization against the deadline, which is what EDF has to fit on a core once deadlines
+     * are shorter than periods */
+    double density() const {
+        std::chrono::nanoseconds deadline = this->relative_deadline();
+        return deadline.count() ? static_cast<double>(this->execution_time.count())
+                                  / deadline.count()
+                                : 0;
+    }
+};
+
+/* Bin packing heuristics. Tasks are always considered in order of decreasing density. */
+enum class FitHeuristic {
+    /* lowest numbered core with room left */
+    first_fit,
+    /* core with the most room left, spreads the load */
+    worst_fit,
+    /* core with the least room left that still fits, packs the load */
+    best_fit,
+};
+
+/* returns false for unknown names */
+bool parse_fit_heuristic(const std::string &name, FitHeuristic *heuristic);
+
+/* Result of partition_tasks: task id -> core, and the density put on every core. For tasks with
+ * implicit deadlines that is their utilization. */
+struct Partition {
+    std::map<int, unsigned> cores;
+    std::vector<double> utilization;
+    /* false if some tasks did not fit and were put on the least loaded core anyway */
+    bool feasible = true;
+};
+
+/* Assign tasks to cores 0 .. n_cores - 1 so that no core's density exceeds capacity (1 is
+ * the EDF bound of a single core). A task that fits nowhere is placed on the least loaded core
+ * and the partition is marked infeasible. */
+Partition partition_tasks(std::vector<TaskLoad> tasks, unsigned n_cores, FitHeuristic heuristic,
+                          double capacity = 1);
+
+/* CPUs the calling thread may run on, i.e. the span of its cpuset. Under global scheduling every
+ * task gets all of them, which SCHED_DEADLINE requires to be a whole root domain. */
+std::vector<unsigned> cpuset_cpus();
+
+/* Outcome of the admission test for global EDF */
+struct GlobalAdmission {
+    double utilization = 0;
+    /* n_cpus * sched_rt_runtime_us / sched_rt_period_us */
+    double limit = 0;
+    bool admitted = false;
+};
+
+/* The kernel admits a SCHED_DEADLINE task into a root domain as long as the total bandwidth stays
+ * below the RT throttling limit on every CPU of it. Checks the bandwidth the tasks start with
+ * against that limit up front. Later budget updates of predicting tasks are not covered. */
+GlobalAdmission admit_global(const std::vector<TaskLoad> &tasks, unsigned n_cpus,
+                             bool prediction_enabled);
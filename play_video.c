@@ -1,3 +1,6 @@
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <time.h>
 #include <unistd.h>
@@ -41,7 +44,7 @@ const AVCodec *codec = NULL;
 struct decode_next_workload {
     int frame_id;
     AVFrame *frame;
-    int finished;
+    atomic_int finished;
 };
 
 struct prepare_workload {
@@ -49,7 +52,7 @@ struct prepare_workload {
     AVFrame *frame;
     AVFrame *scaled_frame;
     uint8_t *buffer;
-    int finished;
+    atomic_int finished;
 };
 
 struct render_workload {
@@ -57,7 +60,7 @@ struct render_workload {
     SDL_Texture *texture;
     AVFrame *scaled_frame;
     double t_to_show;
-    int finished;
+    atomic_int finished;
 };
 
 static double now() {
@@ -75,6 +78,25 @@ static double thread_now() {
 }
 
 
+/* Block until the task finished jobs or timeout_ms passed. Returns the number of finished jobs. */
+static int wait_for_completion(struct pollfd *completion, int timeout_ms) {
+    int ret = poll(completion, 1, timeout_ms);
+    if (ret < 0) {
+        perror("poll");
+        exit(-1);
+    }
+    if (ret == 0 || !(completion->revents & POLLIN)) {
+        return 0;
+    }
+
+    uint64_t n_finished;
+    if (read(completion->fd, &n_finished, sizeof(n_finished)) < 0) {
+        perror("read completion fd");
+        exit(-1);
+    }
+    return n_finished;
+}
+
 static int init_player(int argc, char **argv) {
     if (argc < 2) {
         fprintf(stderr, "Please provide a sourcefile.\n");
@@ -172,19 +194,16 @@ static int init_player(int argc, char **argv) {
     return 0;
 }
 
-static struct metrics decode_metrics(void *workload) {
+static void decode_metrics(void *workload, struct metrics *metrics) {
     struct decode_next_workload *load = workload;
-    struct metrics metrics;
-    metrics.size = 1;
-    metrics.data = malloc(metrics.size * sizeof(double));
+    metrics->size = 1;
     switch (frame_types[load->frame_id]) {
-        case 'I': metrics.data[0] =  8; break;
-        case 'P': metrics.data[0] =  9; break;
-        case 'B': metrics.data[0] = 10; break;
+        case 'I': metrics->data[0] =  8; break;
+        case 'P': metrics->data[0] =  9; break;
+        case 'B': metrics->data[0] = 10; break;
         default: break;
     }
-    //printf("%c-frame. metric: %5.0f\n",frame_types[load->frame_id], metrics.data[0]);
-    return metrics;
+    //printf("%c-frame. metric: %5.0f\n",frame_types[load->frame_id], metrics->data[0]);
 }
 
 static void decode_next(void *workload) {
@@ -313,6 +332,74 @@ static void render(void *render_workload) {
     load->finished = 1;
 }
 
+/* Pipeline state. The forward functions run on the task threads of the stages they forward from. */
+static struct decode_next_workload decode_loads[MAX_DECODE_LOADS];
+static struct prepare_workload prepare_loads[MAX_PREPARE_LOADS];
+static struct render_workload render_loads[MAX_RENDER_LOADS];
+
+static int decode_task_handle = -1;
+static int n_pics_started = 0;
+static atomic_int stop_decoding = 0;
+static int next_prepare_load = 0;
+static int next_render_load = 0;
+static double t_next_pic = 0;
+static double pipeline_frame_period = 0;
+
+/* decode -> prepare: hand the decoded frame to the next prepare load and reuse the decode load for
+ * the next frame. The link guarantees that the prepare load is not in use any more. */
+static void *forward_decoded(void *workload) {
+    struct decode_next_workload *decode_load = workload;
+    if (!decode_load->finished) {
+        return NULL;
+    }
+
+    /* prepare prepare job */
+    struct prepare_workload *prepare_load = &prepare_loads[next_prepare_load];
+    ++next_prepare_load;
+    next_prepare_load %= MAX_PREPARE_LOADS;
+    prepare_load->frame_id = decode_load->frame_id;
+    prepare_load->frame = decode_load->frame;
+    prepare_load->finished = 0;
+    decode_load->frame = NULL;
+
+    /* prepare read job */
+    if (!atomic_load(&stop_decoding) && n_pics_started < N_PICS_TO_SHOW) {
+        decode_load->frame_id = n_pics_started;
+        decode_load->frame = av_frame_alloc();
+        if (decode_load->frame == NULL) {
+            fprintf(stderr, "Error allocating frame.\n");
+            exit(-1);
+        }
+        decode_load->finished = 0;
+
+        /* start decode job */
+        add_job_to_task(decode_task_handle, decode_load);
+        //printf("%10.0f: %4d - submit decode job\n", now(), decode_load->frame_id);
+        ++n_pics_started;
+    }
+
+    //printf("%10.0f: %4d - submit prepare job\n", now(), prepare_load->frame_id);
+    return prepare_load;
+}
+
+/* prepare -> render: schedule the prepared frame for the next display slot */
+static void *forward_prepared(void *workload) {
+    struct prepare_workload *prepare_load = workload;
+
+    /* prepare render load */
+    struct render_workload *render_load = &render_loads[next_render_load];
+    ++next_render_load;
+    next_render_load %= MAX_RENDER_LOADS;
+    render_load->frame_id = prepare_load->frame_id;
+    render_load->scaled_frame = prepare_load->scaled_frame;
+    render_load->t_to_show = t_next_pic;
+    render_load->finished = 0;
+    t_next_pic += pipeline_frame_period;
+
+    //printf("%10.0f: %4d - submit render job\n", now(), render_load->frame_id);
+    return render_load;
+}
+
 
 int main(int argc, char **argv) {
     lttng_ust_tracepoint(play_video, start_main);
@@ -379,31 +466,16 @@ int main(int argc, char **argv) {
         prepare_task = create_task_with_prediction(127, 1, frame_period, prepare, NULL);
         render_task = create_task_with_prediction(127, 2, frame_period, render, NULL);
     }
-    /* wait for tasks to init */
-    SDL_Delay(10);
-
-    struct decode_next_workload decode_loads[MAX_DECODE_LOADS];
-    int first_decode_load = 0;
+    /* the stages forward their results to the next stage themselves */
+    link_tasks(decode_task, prepare_task, forward_decoded, MAX_PREPARE_LOADS);
+    link_tasks(prepare_task, render_task, forward_prepared, MAX_RENDER_LOADS);
+    decode_task_handle = decode_task;
 
-    /* initialise all read jobs and add them to the read task */
-    for (int i = 0; i < MAX_DECODE_LOADS; ++i) {
-        struct decode_next_workload *load = &decode_loads[i];
-        load->frame_id = i;
-        /* init frame */
-        load->frame = av_frame_alloc();
-        if (load->frame == NULL) {
-            fprintf(stderr, "Error allocating frame.\n");
-            exit(-1);
-        }
-        load->finished = 0;
-        /* start job */
-        add_job_to_task(decode_task, load);
-        //printf("%10.0f: %4d - submit decode job\n", now(), i);
-    }
+    /* get notified about rendered frames */
+    struct pollfd render_completion = {.fd = task_completion_fd(render_task), .events = POLLIN};
 
-    struct prepare_workload prepare_loads[MAX_DECODE_LOADS];
-    int first_prepare_load = 0;
-    int n_prepare_loads = 0;
+    /* wait for tasks to init */
+    fprintf(stderr, "tasks ready after %d us\n", wait_for_tasks());
 
     /* initialise all prepare loads */
     int numBytes = av_image_get_buffer_size(AV_PIX_FMT_YUV420P, codec_context->width,
@@ -420,10 +492,6 @@ int main(int argc, char **argv) {
         load->finished = 0;
     }
 
-    struct render_workload render_loads[MAX_RENDER_LOADS];
-    int first_render_load = 0;
-    int n_render_loads = 0;
-
     /* initialise all render loads */
     for (int i = 0; i < MAX_RENDER_LOADS; ++i) {
         struct render_workload *load = &render_loads[i];
@@ -435,10 +503,29 @@ int main(int argc, char **argv) {
         load->finished = 0;
     }
 
-    double t_next_pic = now() + 10 * frame_period;
-    int n_pics_started = MAX_DECODE_LOADS;
+    t_next_pic = now() + 10 * frame_period;
+    pipeline_frame_period = frame_period;
+    n_pics_started = MAX_DECODE_LOADS;
+
+    /* initialise all read jobs and add them to the read task */
+    for (int i = 0; i < MAX_DECODE_LOADS; ++i) {
+        struct decode_next_workload *load = &decode_loads[i];
+        load->frame_id = i;
+        /* init frame */
+        load->frame = av_frame_alloc();
+        if (load->frame == NULL) {
+            fprintf(stderr, "Error allocating frame.\n");
+            exit(-1);
+        }
+        load->finished = 0;
+        /* start job */
+        add_job_to_task(decode_task, load);
+        //printf("%10.0f: %4d - submit decode job\n", now(), i);
+    }
+
+    int n_pics_shown = 0;
     int running = 1;
-    while (running && n_pics_started - MAX_DECODE_LOADS < N_PICS_TO_SHOW) {
+    while (running && n_pics_shown < N_PICS_TO_SHOW) {
         /* check for quit */
         SDL_Event event;
         while (0 != SDL_PollEvent(&event)) {
@@ -448,85 +535,13 @@ int main(int argc, char **argv) {
             }
         }
 
-        /* check if decode job finished */
-        struct decode_next_workload *decode_load = &decode_loads[first_decode_load];
-        if (decode_load->finished && n_prepare_loads < MAX_PREPARE_LOADS) {
-            /* first decode load gets used, so increment index */
-            ++first_decode_load;
-            first_decode_load %= MAX_DECODE_LOADS;
-
-            /* prepare prepare job */
-            int next_prepare_load = (first_prepare_load + n_prepare_loads) % MAX_PREPARE_LOADS;
-            struct prepare_workload *prepare_load = &prepare_loads[next_prepare_load];
-            prepare_load->frame_id = decode_load->frame_id;
-            prepare_load->frame = decode_load->frame;
-            prepare_load->finished = 0;
-            ++n_prepare_loads;
-            /* start prepare job */
-            add_job_to_task(prepare_task, prepare_load);
-            //printf("%10.0f: %4d - submit prepare job\n", now(), prepare_load->frame_id);
-
-            /* prepare read job */
-            decode_load->frame_id = n_pics_started;
-            decode_load->frame = av_frame_alloc();
-            if (decode_load->frame == NULL) {
-                fprintf(stderr, "Error allocating frame.\n");
-                exit(-1);
-            }
-            decode_load->finished = 0;
-
-            /* start decode job */
-            add_job_to_task(decode_task, decode_load);
-            //printf("%10.0f: %4d - submit decode job\n", now(), decode_load->frame_id);
-            //printf("==== start prepare job ====\n"
-            //       "%d of %d prepare loads\n"
-            //       "%d of %d render loads\n",
-            //       n_prepare_loads, MAX_PREPARE_LOADS, n_render_loads, MAX_RENDER_LOADS);
-            ++n_pics_started;
-        }
-
-        /* check if prepare job finished */
-        struct prepare_workload *prepare_load = &prepare_loads[first_prepare_load];
-        if (n_prepare_loads && prepare_load->finished && n_render_loads < MAX_RENDER_LOADS) {
-            /* first prepare load gets used, so increment index and decrement count */
-            ++first_prepare_load;
-            first_prepare_load %= MAX_PREPARE_LOADS;
-            --n_prepare_loads;
-
-            /* prepare render load */
-            int next_render_load = (first_render_load + n_render_loads) % MAX_RENDER_LOADS;
-            struct render_workload *render_load = &render_loads[next_render_load];
-            render_load->frame_id = prepare_load->frame_id;
-            render_load->scaled_frame = prepare_load->scaled_frame;
-            render_load->t_to_show = t_next_pic;
-            render_load->finished = 0;
-            ++n_render_loads;
-            t_next_pic += frame_period;
-
-            /* start render job */
-            add_job_to_task(render_task, render_load);
-            //printf("%10.0f: %4d - submit render job\n", now(), render_load->frame_id);
-            //printf("==== start render job ====\n"
-            //       "%d of %d prepare loads\n"
-            //       "%d of %d render loads\n",
-            //       n_prepare_loads, MAX_PREPARE_LOADS, n_render_loads, MAX_RENDER_LOADS);
-        }
-
-
-        struct render_workload *render_load = &render_loads[first_render_load];
-        if (n_render_loads && render_load->finished) {
-            ++first_render_load;
-            first_render_load %= MAX_RENDER_LOADS;
-            --n_render_loads;
-
-            //printf("==== render job finished ====\n"
-            //       "%d of %d prepare loads\n"
-            //       "%d of %d render loads\n",
-            //       n_prepare_loads, MAX_PREPARE_LOADS, n_render_loads, MAX_RENDER_LOADS);
-        }
-        SDL_Delay(1);
+        /* sleep until frames got rendered. The timeout keeps the SDL events going */
+        n_pics_shown += wait_for_completion(&render_completion, 10);
     }
 
+    /* let the pipeline run dry */
+    atomic_store(&stop_decoding, 1);
+
     /* join tasks */
     release_sem(decode_task);
     join_task(decode_task);
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+
+/* Runtimes kept per task for inspection. Older ones are overwritten. */
+constexpr std::size_t runtime_history_capacity = 256;
+
+/* Snapshot of a task's runtime statistics over all jobs so far, in ns. Percentiles are approximate,
+ * see RuntimeHistory. */
+struct RuntimeStats {
+    long count = 0;
+    double mean = 0;
+    double variance = 0;
+    double min = 0;
+    double max = 0;
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+};
+
+/* Fixed-size runtime history with streaming statistics.
+ *
+ * Written by the task thread only, after every job, in constant time and without allocating. Any
+ * other thread may read at the same time: readers go through a sequence lock and retry if a job
+ * finished while they were reading, so the writer never waits for them.
+ *
+ * Mean and variance are kept with Welford's algorithm. Percentiles come from a log-linear histogram
+ * with sub_buckets buckets per power of two, which bounds their relative error by
+ * 1 / (2 * sub_buckets). */
+class RuntimeHistory {
+    static constexpr int sub_bucket_bits = 3;
+    static constexpr int sub_buckets = 1 << sub_bucket_bits;
+    /* runtimes up to 2^48 ns (about three days) */
+    static constexpr int n_octaves = 48;
+    static constexpr int n_buckets = n_octaves * sub_buckets;
+
+    std::atomic<unsigned> _sequence = 0;
+
+    std::atomic<long> _count = 0;
+    std::atomic<double> _mean = 0;
+    std::atomic<double> _m2 = 0;
+    std::atomic<double> _min = 0;
+    std::atomic<double> _max = 0;
+
+    std::atomic<double> _recent[runtime_history_capacity] = {};
+    std::atomic<uint32_t> _histogram[n_buckets] = {};
+
+    static int bucket(double runtime) {
+        uint64_t ns = runtime < 1 ? 1 : static_cast<uint64_t>(runtime);
+        int octave = std::bit_width(ns) - 1;
+        if (octave < sub_bucket_bits) {
+            return ns;
+        }
+        int sub = (ns >> (octave - sub_bucket_bits)) & (sub_buckets - 1);
+        return std::min((octave - sub_bucket_bits + 1) * sub_buckets + sub, n_buckets - 1);
+    }
+
+    /* middle of the values that fall into bucket i */
+    static double bucket_value(int i) {
+        if (i < sub_buckets) {
+            return i;
+        }
+        int octave = i / sub_buckets + sub_bucket_bits - 1;
+        int sub = i % sub_buckets;
+        double width = std::ldexp(1, octave - sub_bucket_bits);
+        return std::ldexp(1, octave) + (sub + 0.5) * width;
+    }
+
+    template <typename Read>
+    void read_consistent(Read read) const {
+        while (true) {
+            unsigned begin = this->_sequence.load(std::memory_order_acquire);
+            if (begin % 2) {
+                continue;
+            }
+            read();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (this->_sequence.load(std::memory_order_relaxed) == begin) {
+                return;
+            }
+        }
+    }
+
+    double histogram_percentile(double q, long count) const {
+        long rank = std::max(1l, static_cast<long>(std::ceil(q * count)));
+        long seen = 0;
+        for (int i = 0; i < n_buckets; ++i) {
+            seen += this->_histogram[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return bucket_value(i);
+            }
+        }
+        return this->_max.load(std::memory_order_relaxed);
+    }
+
+  public:
+    /* task thread only */
+    void add(double runtime) {
+        constexpr auto relaxed = std::memory_order_relaxed;
+        unsigned sequence = this->_sequence.load(relaxed);
+        this->_sequence.store(sequence + 1, relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        long count = this->_count.load(relaxed) + 1;
+        double mean = this->_mean.load(relaxed);
+        double delta = runtime - mean;
+        mean += delta / count;
+        this->_m2.store(this->_m2.load(relaxed) + delta * (runtime - mean), relaxed);
+        this->_mean.store(mean, relaxed);
+        if (count == 1 or runtime < this->_min.load(relaxed)) {
+            this->_min.store(runtime, relaxed);
+        }
+        if (count == 1 or runtime > this->_max.load(relaxed)) {
+            this->_max.store(runtime, relaxed);
+        }
+
+        this->_recent[(count - 1) % runtime_history_capacity].store(runtime, relaxed);
+        auto &bucket = this->_histogram[RuntimeHistory::bucket(runtime)];
+        bucket.store(bucket.load(relaxed) + 1, relaxed);
+        this->_count.store(count, relaxed);
+
+        this->_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    /* number of runtimes added so far. Exact on the task thread, a snapshot otherwise */
+    long count() const {
+        return this->_count.load(std::memory_order_relaxed);
+    }
+
+    RuntimeStats stats() const {
+        RuntimeStats stats;
+        this->read_consistent([this, &stats] {
+            stats.count = this->_count.load(std::memory_order_relaxed);
+            if (stats.count == 0) {
+                stats = RuntimeStats();
+                return;
+            }
+            stats.mean = this->_mean.load(std::memory_order_relaxed);
+            stats.variance = stats.count > 1
+                             ? this->_m2.load(std::memory_order_relaxed) / (stats.count - 1)
+                             : 0;
+            stats.min = this->_min.load(std::memory_order_relaxed);
+            stats.max = this->_max.load(std::memory_order_relaxed);
+            stats.p50 = this->histogram_percentile(0.5, stats.count);
+            stats.p90 = this->histogram_percentile(0.9, stats.count);
+            stats.p99 = this->histogram_percentile(0.99, stats.count);
+        });
+        return stats;
+    }
+
+    /* approximate q-quantile (0 < q <= 1) of all runtimes so far */
+    double percentile(double q) const {
+        double value = 0;
+        this->read_consistent([this, q, &value] {
+            long count = this->_count.load(std::memory_order_relaxed);
+            value = count ? this->histogram_percentile(q, count) : 0;
+        });
+        return value;
+    }
+
+    /* copy up to n of the most recent runtimes to out, oldest first. Returns how many were
+     * copied */
+    std::size_t recent(double *out, std::size_t n) const {
+        std::size_t copied = 0;
+        this->read_consistent([this, out, n, &copied] {
+            long count = this->_count.load(std::memory_order_relaxed);
+            copied = std::min({n, runtime_history_capacity, static_cast<std::size_t>(count)});
+            for (std::size_t i = 0; i < copied; ++i) {
+                long index = count - copied + i;
+                out[i] = this->_recent[index % runtime_history_capacity]
+                         .load(std::memory_order_relaxed);
+            }
+        });
+        return copied;
+    }
+};
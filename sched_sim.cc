@@ -4,157 +4,485 @@
 //#include <string.h>
 //#include <time.h>
 
+#include <getopt.h>
+
 #include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <latch>
+#include <limits>
 #include <map>
-#include <semaphore>
+#include <memory>
+#include <span>
 #include <sstream>
 #include <thread>
+#include <tuple>
 #include <vector>
 
+#include "binary_trace.h"
+#include "interference.h"
+#include "job_sort.h"
+#include "kernels.h"
+#include "offline_sim.h"
+#include "partition.h"
 #include "rt.h"
 #include "sched_sim_tracepoint.h"
+#include "sim_input.h"
+#include "spawn_timer.h"
+#include "sweep.h"
 #include "task.h"
+#include "task_pool.h"
 
 using namespace std::chrono_literals;
 using time_point = std::chrono::time_point<std::chrono::steady_clock>;
 using duration = typename std::chrono::nanoseconds;
 
-struct Job {
-    int _id;
-    duration _execution_time;
-    time_point _deadline;
-    time_point _submission_time;
-    int _task_id;
+/* found by Task through ADL, orders jobs in EDF mode */
+time_point job_deadline(const Job &job) {
+    return job._deadline;
+}
+
+/* found by Task through ADL, traces jobs under the id sched_sim:job_spawn has for them */
+int job_id(const Job &job, long sequence) {
+    (void)sequence;
+    return job._id;
+}
+
+/* runs every job of a task on the task's kernel */
+struct RunKernel {
+    Kernel *kernel;
+
+    void operator()(Job job) const {
+        this->kernel->run(job._execution_time);
+    }
 };
 
-using SimTask = Task<Job>;
+/* fraction of the execution time a degraded job runs for */
+static double degrade_factor = 0.5;
+
+/* runs late jobs of a task for degrade_factor of their execution time, see --late-policy */
+struct RunDegraded {
+    Kernel *kernel = nullptr;
 
-void wait_busily(Job job) {
-    time_point thread_end = thread_now() + job._execution_time;
-    while (thread_now() < thread_end) {
-        /* spin */
+    void operator()(Job job) const {
+        this->kernel->run(std::chrono::duration_cast<duration>(job._execution_time
+                                                               * degrade_factor));
+    }
+
+    explicit operator bool() const {
+        return this->kernel != nullptr;
+    }
+};
+
+/* records the lateness in ns of every job of a task that ran, by job id, see --lateness */
+struct RecordLateness {
+    std::vector<int64_t> *lateness = nullptr;
+
+    void operator()(Job job) const {
+        (*this->lateness)[job._id] = (std::chrono::steady_clock::now() - job._deadline) / 1ns;
+    }
+
+    explicit operator bool() const {
+        return this->lateness != nullptr;
+    }
+};
+
+using SimTask = Task<Job, SpscRing, RunKernel, NoMetrics<Job>, RecordLateness, RunDegraded>;
+
+/* move jobs from times relative to the start of the run to absolute ones */
+static void shift_jobs(std::span<Job> jobs, time_point start) {
+    for (Job &job: jobs) {
+        job._deadline += start.time_since_epoch();
+        job._submission_time += start.time_since_epoch();
     }
 }
 
 struct Model {
-    std::map<int, SimTask*> _tasks;
+    /* tasks as declared in the input, by task index. The SimTasks are only created once they are
+     * partitioned */
+    std::vector<TaskLoad> _task_loads;
+    std::vector<SimTask *> _tasks;
+    /* the kernel of tasks that name one by task id, others spin */
+    std::map<int, KernelSpec> _kernel_specs;
+    std::vector<std::unique_ptr<Kernel>> _kernels;
+    /* background load next to the tasks, real runs only */
+    std::vector<InterferenceSpec> _interference;
     std::vector<Job> _jobs;
     int _n_cores = 1;
     bool _prediction_enabled = false;
+    /* jobs are in spawn order already */
+    bool _jobs_sorted = false;
 
     time_point _start = time_point(0us);
 
-    void add_task(SimTask *task) {
-        this->_tasks[task->id()] = task;
+    void add_task(TaskLoad task) {
+        this->_task_loads.push_back(task);
     }
 
-    void calculate_deadlines() {
-        std::map<int, std::vector<Job *>> tasks_jobs;
-        for (Job &j: this->_jobs) {
-            tasks_jobs[j._task_id].push_back(&j);
-        }
-        time_point zero(0us);
-        for (auto &[task_id, jobs]: tasks_jobs) {
-            if (not this->_tasks.contains(task_id)) {
-                std::cerr << "Input Error: unresolvable task id: " << task_id << std::endl;
-                exit(EXIT_FAILURE);
-            }
-            SimTask *task = this->_tasks[task_id];
-            int i = 1;
-            for (Job *job: jobs) {
-                job->_deadline = zero + (task->period() * i);
-                job->_id = i - 1;
-                //std::cerr << "calculate job " << i << " of task " << task_id << ". submission: "
-                //          << job->_submission_time.time_since_epoch() / 1us << ". deadline: "
-                //          << job->_deadline.time_since_epoch() / 1us << ". execution_time: "
-                //          << job->_execution_time / 1us << std::endl;
-                ++i;
+    /* created and calibrated on the calling thread */
+    RunKernel kernel_of(uint32_t task) {
+        auto spec = this->_kernel_specs.find(this->_task_loads[task].id);
+        this->_kernels.resize(this->_task_loads.size());
+        this->_kernels[task] = std::make_unique<Kernel>(spec != this->_kernel_specs.end()
+                                                        ? spec->second : KernelSpec());
+        return RunKernel{this->_kernels[task].get()};
+    }
+
+    /* With prediction the task starts at 90% of its relative deadline and follows the predictions,
+     * without it reserves the declared execution time. With pools, the task takes its thread from
+     * there once it starts */
+    SimTask *create_task(uint32_t task, const std::vector<unsigned> &cpus, TaskThreadPools *pools) {
+        const TaskLoad &load = this->_task_loads[task];
+        TaskThreadPool *pool = pools ? pools->pool_for(cpus) : nullptr;
+        if (this->_prediction_enabled) {
+            return new SimTask(load.id, load.period, load.relative_deadline(),
+                               this->kernel_of(task), cpus, pool);
+        }
+        return new SimTask(load.id, load.period, load.relative_deadline(), this->kernel_of(task),
+                           load.execution_time, cpus, pool);
+    }
+
+    /* pin every task to the core the partition assigned to it and start it. Core i is the i-th of
+     * the given cpus, of which there are at least as many as cores */
+    void create_tasks(const Partition &partition, const std::vector<unsigned> &cores,
+                      TaskThreadPools *pools) {
+        for (uint32_t i = 0; i < this->_task_loads.size(); ++i) {
+            std::vector<unsigned> cpus = {cores.at(partition.cores.at(this->_task_loads[i].id))};
+            this->_tasks.push_back(this->create_task(i, cpus, pools));
+        }
+    }
+
+    /* let every task run on all of cpus and leave placement to the kernel's global EDF */
+    void create_global_tasks(const std::vector<unsigned> &cpus, TaskThreadPools *pools) {
+        for (uint32_t i = 0; i < this->_task_loads.size(); ++i) {
+            this->_tasks.push_back(this->create_task(i, cpus, pools));
+        }
+    }
+
+    const std::vector<TaskLoad> &task_loads() const {
+        return this->_task_loads;
+    }
+
+    /* by task index, the tasks with a job in the first release. All of them if the jobs are not
+     * loaded, as when streaming */
+    std::vector<bool> first_released() const {
+        if (this->_jobs.empty()) {
+            return std::vector<bool>(this->_tasks.size(), true);
+        }
+        std::vector<bool> released(this->_tasks.size(), false);
+        time_point first = std::min_element(this->_jobs.begin(), this->_jobs.end(),
+                                            [](const Job &a, const Job &b) {
+                                                return a._submission_time < b._submission_time;
+                                            })->_submission_time;
+        for (const Job &job: this->_jobs) {
+            if (job._submission_time == first) {
+                released[job._task] = true;
             }
         }
+        return released;
     }
 
-    void set_start_time(time_point start) {
-        this->_start = start;
+    /* number the jobs of every task in input order and give them deadlines after their release */
+    void calculate_deadlines() {
+        std::vector<JobNumbering> numbering(this->_task_loads.size());
         for (Job &job: this->_jobs) {
-            job._deadline += start.time_since_epoch();
-            job._submission_time += start.time_since_epoch();
+            numbering[job._task].number(this->_task_loads[job._task], &job);
         }
     }
 
+    void set_start_time(time_point start) {
+        this->_start = start;
+        shift_jobs(this->_jobs, start);
+    }
+
+    /* jobs of one task that are submitted at the same time end up next to each other, so they can
+     * be spawned as one batch */
     void sort_jobs() {
+        if (this->_jobs_sorted) {
+            return;
+        }
+        this->_jobs_sorted = true;
         std::sort(this->_jobs.begin(), this->_jobs.end(),
                   [](const Job &a, const Job &b){
-                      return a._submission_time < b._submission_time;
+                      return std::tie(a._submission_time, a._task, a._id)
+                             < std::tie(b._submission_time, b._task, b._id);
                   });
     }
 };
 
-static Job parse_job(std::stringstream *ss) {
-    int id;
-    int execution_time;
-    int submission_time;
-    int task_id;
-    *ss >> id >> execution_time >> submission_time >> task_id;
-    return Job(id, execution_time * 1us, time_point{0us}, time_point{submission_time * 1us},
-               task_id);
+/* model of the input's core count and tasks, without jobs */
+static struct Model model_from(const SimInput &input, bool prediction_enabled) {
+    Model model;
+    model._prediction_enabled = prediction_enabled;
+    model._n_cores = input.n_cores;
+    for (const TaskLoad &task: input.tasks) {
+        model.add_task(task);
+    }
+    model._kernel_specs = input.kernels;
+    model._interference = input.interference;
+    return model;
 }
 
-static SimTask *parse_task(std::stringstream *ss, Model *model) {
-    int id;
-    int execution_time;
-    int period;
-    *ss >> id >> execution_time >> period;
-    std::vector<unsigned> cpus = {0};
-    return new SimTask(id, period * 1us, wait_busily, cpus);
+static struct Model parse_input(std::string path, bool prediction_enabled) {
+    SimInput input = parse_sim_input(path);
+
+    Model model = model_from(input, prediction_enabled);
+    model._jobs = std::move(input.jobs);
+
+    /* binary traces come sorted and numbered */
+    if (input.numbered) {
+        model._jobs_sorted = true;
+    } else if (model._jobs.size() >= parallel_sort_threshold) {
+        number_and_sort_jobs(&model._jobs, model._task_loads, cpuset_cpus().size());
+        model._jobs_sorted = true;
+    } else {
+        model.calculate_deadlines();
+    }
+
+    return model;
 }
 
-static void parse_line(std::string line, Model *model) {
-    std::stringstream ss(line);
-    char type = ' ';
-    /* first char in each line specifies type of line to parse */
-    ss >> type;
-    switch (type) {
-        break; case 'c': ss >> model->_n_cores;
-        break; case 'j': model->_jobs.push_back(parse_job(&ss));
-        break; case 'S': model->add_task(parse_task(&ss, model));
-        break; case ' ':
-        break; case 0:
-        break; case '#':
-        break; default: std::cerr << "Parse error: \"" << type << "\" is not a proper type."
-                                  << std::endl;
-                        exit(EXIT_FAILURE);
-    }
+struct Options {
+    std::string input;
+    bool prediction_enabled = false;
+    /* overrides the input's core count if set */
+    int n_cores = 0;
+    /* dedicated spawners run on these in turn */
+    std::vector<unsigned> spawner_cpus = {7};
+    int n_spawners = 1;
+    /* run every spawner on the cpus of its tasks instead */
+    bool colocate_spawners = false;
+    /* take task threads from pools, with this many started per task cpu ahead of the tasks */
+    bool task_pool = false;
+    std::size_t task_pool_prestart = 0;
+    bool report_lateness = false;
+    /* read pre-sorted input while spawning instead of loading it first */
+    bool stream = false;
+    /* convert the input to this file instead of running it */
+    std::string to_binary;
+    std::string to_text;
+    BudgetPolicy budget_policy;
+    FitHeuristic fit = FitHeuristic::first_fit;
+    bool global = false;
+    JobOrder job_order = JobOrder::fifo;
+    LatePolicy late_policy = LatePolicy::run;
+    bool offline = false;
+};
+
+static void usage(const char *name) {
+    std::cerr << "usage: " << name << " [options] INPUT_FILE [PREDICTION_ENABLED]\n"
+              << "  PREDICTION_ENABLED              1 to enable runtime prediction. Otherwise\n"
+              << "                                  tasks reserve their declared execution time\n"
+              << "budget updates (prediction only):\n"
+              << "  --budget-rel-threshold=FRAC     skip changes below FRAC of the runtime\n"
+              << "  --budget-abs-threshold=US       skip changes below US microseconds. Changes\n"
+              << "                                  have to pass both thresholds to be applied\n"
+              << "  --budget-min-interval=US        at most one update every US microseconds\n"
+              << "  --budget-lower-lazily           raise at once, only delay decreases\n"
+              << "  --budget-headroom=FRAC          reserve FRAC more than each prediction\n"
+              << "placement:\n"
+              << "  --cores=N                       use N cores instead of the input's count\n"
+              << "  --spawner-cpu=CPU,...           spawn jobs from CPU (default 7). Tasks avoid\n"
+              << "                                  these as long as enough other cpus are left\n"
+              << "  --spawners=N                    release jobs from N threads, each owning a\n"
+              << "                                  share of the tasks. They take the spawner cpus\n"
+              << "                                  in turn\n"
+              << "  --colocate-spawners             run each spawner on the cpus of its tasks\n"
+              << "  --task-pool[=N]                 take task threads from per-cpu pools. N threads\n"
+              << "                                  per task cpu are started while the input is read.\n"
+              << "                                  Tasks without a job in the first release start\n"
+              << "                                  on their first job. Tasks run until the end, so\n"
+              << "                                  threads are not reused within one run\n"
+              << "  --partition=first-fit|worst-fit|best-fit\n"
+              << "                                  how tasks are packed onto the input's cores\n"
+              << "  --global                        no partitioning, tasks migrate freely within\n"
+              << "                                  the cpuset sched_sim was started in\n"
+              << "  --offline                       simulate the schedule in virtual time and\n"
+              << "                                  print each job's lateness instead of running it\n"
+              << "job order:\n"
+              << "  --edf                           serve pending jobs earliest deadline first\n"
+              << "  --late-policy=run|skip|degrade  handling of jobs already past their deadline\n"
+              << "  --degrade-factor=F              degraded jobs run F times their execution time\n"
+              << "  --stream                        read jobs while spawning them. Needs input\n"
+              << "                                  sorted by submission time\n"
+              << "output:\n"
+              << "  --lateness                      print each job's lateness like --offline does\n"
+              << "conversion:\n"
+              << "  --to-binary=FILE                write the input as a binary trace and exit\n"
+              << "  --to-text=FILE                  write the input as a text trace and exit\n"
+              << "\n"
+              << "       " << name << " sweep [grid options] INPUT_FILE... [-- OPTIONS]\n"
+              << "  evaluate every combination of the grid, see " << name << " sweep --help"
+              << std::endl;
 }
 
-static struct Model parse_input(std::string path, bool prediction_enabled) {
-    std::ifstream input_file(path);
-    if (not input_file.is_open()) {
-        std::cerr << "Could not open file: " << path << std::endl;
-        exit(EXIT_FAILURE);
+static Options parse_options(int argc, char *argv[]) {
+    enum {
+        BUDGET_REL_THRESHOLD = 256,
+        BUDGET_ABS_THRESHOLD,
+        BUDGET_MIN_INTERVAL,
+        BUDGET_LOWER_LAZILY,
+        BUDGET_HEADROOM,
+        CORES,
+        SPAWNER_CPU,
+        SPAWNERS,
+        COLOCATE_SPAWNERS,
+        TASK_POOL,
+        PARTITION,
+        GLOBAL,
+        OFFLINE,
+        EDF,
+        LATE_POLICY,
+        DEGRADE_FACTOR,
+        LATENESS,
+        STREAM,
+        TO_BINARY,
+        TO_TEXT,
+    };
+    static const struct option long_options[] = {
+        {"budget-rel-threshold", required_argument, nullptr, BUDGET_REL_THRESHOLD},
+        {"budget-abs-threshold", required_argument, nullptr, BUDGET_ABS_THRESHOLD},
+        {"budget-min-interval", required_argument, nullptr, BUDGET_MIN_INTERVAL},
+        {"budget-lower-lazily", no_argument, nullptr, BUDGET_LOWER_LAZILY},
+        {"budget-headroom", required_argument, nullptr, BUDGET_HEADROOM},
+        {"cores", required_argument, nullptr, CORES},
+        {"spawner-cpu", required_argument, nullptr, SPAWNER_CPU},
+        {"spawners", required_argument, nullptr, SPAWNERS},
+        {"colocate-spawners", no_argument, nullptr, COLOCATE_SPAWNERS},
+        {"task-pool", optional_argument, nullptr, TASK_POOL},
+        {"partition", required_argument, nullptr, PARTITION},
+        {"global", no_argument, nullptr, GLOBAL},
+        {"offline", no_argument, nullptr, OFFLINE},
+        {"edf", no_argument, nullptr, EDF},
+        {"late-policy", required_argument, nullptr, LATE_POLICY},
+        {"degrade-factor", required_argument, nullptr, DEGRADE_FACTOR},
+        {"lateness", no_argument, nullptr, LATENESS},
+        {"stream", no_argument, nullptr, STREAM},
+        {"to-binary", required_argument, nullptr, TO_BINARY},
+        {"to-text", required_argument, nullptr, TO_TEXT},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    Options options;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", long_options, nullptr)) != -1) {
+        switch (opt) {
+            break; case BUDGET_REL_THRESHOLD:
+                options.budget_policy.relative_threshold = std::stod(optarg);
+            break; case BUDGET_ABS_THRESHOLD:
+                options.budget_policy.absolute_threshold = std::stol(optarg) * 1us;
+            break; case BUDGET_MIN_INTERVAL:
+                options.budget_policy.min_interval = std::stol(optarg) * 1us;
+            break; case BUDGET_LOWER_LAZILY:
+                options.budget_policy.lower_lazily = true;
+            break; case BUDGET_HEADROOM:
+                options.budget_policy.headroom = std::stod(optarg);
+            break; case CORES:
+                options.n_cores = std::stoi(optarg);
+            break; case SPAWNER_CPU:
+                options.spawner_cpus.clear();
+                for (std::stringstream list(optarg); list.good();) {
+                    std::string cpu;
+                    std::getline(list, cpu, ',');
+                    options.spawner_cpus.push_back(std::stoul(cpu));
+                }
+            break; case SPAWNERS:
+                options.n_spawners = std::stoi(optarg);
+                if (options.n_spawners < 1) {
+                    std::cerr << "need at least one spawner" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+            break; case COLOCATE_SPAWNERS:
+                options.colocate_spawners = true;
+            break; case TASK_POOL:
+                options.task_pool = true;
+                if (optarg) {
+                    options.task_pool_prestart = std::stoul(optarg);
+                }
+            break; case PARTITION:
+                if (not parse_fit_heuristic(optarg, &options.fit)) {
+                    std::cerr << "unknown partitioning heuristic: " << optarg << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+            break; case GLOBAL:
+                options.global = true;
+            break; case OFFLINE:
+                options.offline = true;
+            break; case EDF:
+                options.job_order = JobOrder::edf;
+            break; case LATE_POLICY:
+                if (std::string(optarg) == "run") {
+                    options.late_policy = LatePolicy::run;
+                } else if (std::string(optarg) == "skip") {
+                    options.late_policy = LatePolicy::skip;
+                } else if (std::string(optarg) == "degrade") {
+                    options.late_policy = LatePolicy::degrade;
+                } else {
+                    std::cerr << "unknown late policy: " << optarg << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+            break; case DEGRADE_FACTOR:
+                degrade_factor = std::stod(optarg);
+            break; case LATENESS:
+                options.report_lateness = true;
+            break; case STREAM:
+                options.stream = true;
+            break; case TO_BINARY:
+                options.to_binary = optarg;
+            break; case TO_TEXT:
+                options.to_text = optarg;
+            break; case 'h':
+                usage(argv[0]);
+                exit(EXIT_SUCCESS);
+            break; default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
     }
 
-    Model model;
-    model._prediction_enabled = prediction_enabled;
-    std::string line;
-    while (std::getline(input_file, line)) {
-        parse_line(line, &model);
+    if (optind >= argc) {
+        std::cerr << "no input file provided. Exiting." << std::endl;
+        exit(1);
+    }
+    options.input = argv[optind];
+    if (options.stream and (options.offline or options.report_lateness)) {
+        std::cerr << "--stream only works for real runs without --lateness" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (options.stream and (options.n_spawners > 1 or options.colocate_spawners)) {
+        std::cerr << "--stream needs a single dedicated spawner" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (optind + 1 < argc && std::string(argv[optind + 1]) == "1") {
+        options.prediction_enabled = true;
     }
-    input_file.close();
-
-    model.calculate_deadlines();
 
-    return model;
+    return options;
 }
 
-int main(int argc, char *argv[]) {
-    lttng_ust_tracepoint(sched_sim, start_main);
+/* a thread that releases jobs. Each task is fed by one spawner only, so it keeps a single
+ * producer */
+struct Spawner {
+    std::vector<unsigned> cpus;
+    /* jobs of the spawner's tasks in spawn order, unless they are streamed */
+    JobTable jobs;
+    std::unique_ptr<SpawnTimer> timer;
+    std::thread thread;
+
+    JitterHistogram jitter;
+    long n_jobs = 0;
+    /* time from waking up until the batch was handed over, summed over all batches */
+    duration busy = duration(0);
+};
 
-    /* put the job spawning onto CPU 7 */
+/* pin the calling thread to cpus and let it preempt the normal threads there */
+static void become_spawner(const std::vector<unsigned> &cpus) {
     cpu_set_t set;
     CPU_ZERO(&set);
-    CPU_SET(7,&set);
+    for (unsigned cpu: cpus) {
+        CPU_SET(cpu, &set);
+    }
 
     int ret;
     ret = sched_setaffinity(0, sizeof(set), &set);
@@ -181,61 +509,399 @@ int main(int argc, char *argv[]) {
         perror("sched_setattr");
         exit(-1);
     }
+}
 
-    if (argc <= 1) {
-        std::cerr << "no input file provided. Exiting." << std::endl;
-        exit(1);
+/* hand every job to its task at its submission time */
+static void spawn_jobs(Model *model, JobSource *source, Spawner *spawner) {
+    for (std::span<const Job> batch = source->next_batch(); not batch.empty();
+         batch = source->next_batch()) {
+        const Job &job = batch.front();
+        time_point now = spawner->timer->wait_until(job._submission_time);
+
+        /* spawn jobs. All jobs of a batch belong to the same task and are spawned at once */
+        SimTask *task = model->_tasks[job._task];
+        for (const Job &j: batch) {
+            lttng_ust_tracepoint(sched_sim, job_spawn, task->id(), j._id, (j._deadline - now.time_since_epoch()).time_since_epoch() / 1ns);
+            spawner->jitter.add(now - j._submission_time);
+        }
+
+        task->add_jobs(batch);
+        spawner->n_jobs += batch.size();
+        spawner->busy += std::chrono::steady_clock::now() - now;
     }
+}
 
-    bool prediction_enabled = false;
-    if (argc > 2 && std::string(argv[2]) == "1") {
-        prediction_enabled = true;
+/* Split the tasks among n spawners. Colocated spawners take whole groups of tasks that share
+ * their cpus and run on those, as long as there are enough groups. Otherwise spawners take every
+ * n-th task and dedicated ones run on the spawner cpus in turn. Moves the sorted jobs of the model
+ * to their spawners. */
+static std::vector<Spawner> shard_spawners(Model *model, int n, bool colocate,
+                                           const std::vector<unsigned> &spawner_cpus) {
+    std::map<std::vector<unsigned>, std::vector<uint32_t>> groups;
+    for (uint32_t task = 0; task < model->_tasks.size(); ++task) {
+        groups[colocate ? model->_tasks[task]->cpus() : std::vector<unsigned>()].push_back(task);
+    }
+    n = std::min<std::size_t>(n, model->_tasks.size());
+    std::vector<Spawner> spawners(n);
+
+    /* spawner by task index */
+    std::vector<int> task_spawner(model->_tasks.size());
+    int next = 0;
+    for (auto &[cpus, tasks]: groups) {
+        for (uint32_t task: tasks) {
+            task_spawner[task] = next;
+            if (groups.size() < spawners.size()) {
+                next = (next + 1) % n;
+            }
+        }
+        if (groups.size() >= spawners.size()) {
+            next = (next + 1) % n;
+        }
     }
 
-    Model model = parse_input(argv[1], prediction_enabled);
+    for (uint32_t task = 0; task < task_spawner.size(); ++task) {
+        int i = task_spawner[task];
+        if (colocate) {
+            for (unsigned cpu: model->_tasks[task]->cpus()) {
+                if (std::find(spawners[i].cpus.begin(), spawners[i].cpus.end(), cpu)
+                    == spawners[i].cpus.end()) {
+                    spawners[i].cpus.push_back(cpu);
+                }
+            }
+        } else {
+            spawners[i].cpus = {spawner_cpus[i % spawner_cpus.size()]};
+        }
+    }
 
-    lttng_ust_tracepoint(sched_sim, input_parsed);
+    model->sort_jobs();
+    for (const Job &job: model->_jobs) {
+        spawners[task_spawner[job._task]].jobs.push_back(job);
+    }
+    std::vector<Job>().swap(model->_jobs);
+    return spawners;
+}
 
-    /* Allow tasks to initialise */
-    std::this_thread::sleep_for(3ms);
+/* Start a thread per spawner and release all jobs from them as soon as every spawner is
+ * calibrated */
+static void spawn_sharded(Model *model, std::vector<Spawner> *spawners) {
+    std::latch calibrated(spawners->size());
+    std::latch go(1);
+    for (Spawner &spawner: *spawners) {
+        spawner.thread = std::thread([model, &spawner, &calibrated, &go]() {
+            become_spawner(spawner.cpus);
+            spawner.timer = std::make_unique<SpawnTimer>();
+            calibrated.count_down();
+            go.wait();
+
+            spawn_jobs(model, &spawner.jobs, &spawner);
+        });
+    }
 
-    lttng_ust_tracepoint(sched_sim, waited_for_task_init);
+    calibrated.wait();
+    time_point start = std::chrono::steady_clock::now();
+    model->set_start_time(start);
+    for (Spawner &spawner: *spawners) {
+        spawner.jobs.set_start_time(start);
+    }
+    go.count_down();
+
+    for (Spawner &spawner: *spawners) {
+        spawner.thread.join();
+    }
+}
 
-    /* wait at least one period for every task */
-    duration initial_wait =
-        std::max_element(model._tasks.begin(), model._tasks.end(),
-                         [](std::pair<int, SimTask *> a, std::pair<int, SimTask *> b) {
-                             return a.second->period() < b.second->period();
-                         })->second->period();
-    model.set_start_time(std::chrono::steady_clock::now() + initial_wait);
+/* Jitter of all spawners and the release rate each could keep up, judged by the time it took to
+ * hand over the jobs it released */
+static void print_spawners(const std::vector<Spawner> &spawners) {
+    JitterHistogram jitter;
+    double total_rate = 0;
+    for (std::size_t i = 0; i < spawners.size(); ++i) {
+        const Spawner &spawner = spawners[i];
+        double rate = spawner.busy > 0ns
+                      ? spawner.n_jobs / std::chrono::duration<double>(spawner.busy).count()
+                      : 0;
+        total_rate += rate;
+        jitter.merge(spawner.jitter);
+
+        std::cerr << "spawner " << i << " on cpu";
+        for (unsigned cpu: spawner.cpus) {
+            std::cerr << " " << cpu;
+        }
+        std::cerr << ": " << spawner.n_jobs << " jobs, busy " << spawner.busy / 1us
+                  << " us, up to " << static_cast<long>(rate) << " jobs/s, slack "
+                  << spawner.timer->slack() / 1us << " us, " << spawner.timer->late_wakeups()
+                  << " late wakeups" << std::endl;
+    }
+    if (spawners.size() > 1) {
+        std::cerr << "all spawners: up to " << static_cast<long>(total_rate) << " jobs/s"
+                  << std::endl;
+    }
+    jitter.print(std::cerr);
+}
 
-    /* spawn jobs */
+/* replay the input in virtual time. Prints "j <job> <lateness in ns>" per job and task, like
+ * eval.py does for a traced run */
+static int run_offline(const Options &options) {
+    auto wall_start = std::chrono::steady_clock::now();
+    Model model = parse_input(options.input, options.prediction_enabled);
+    if (options.n_cores > 0) {
+        model._n_cores = options.n_cores;
+    }
     model.sort_jobs();
-    time_point now = std::chrono::steady_clock::now();
-    for (Job &job: model._jobs) {
+    if (not model._interference.empty()) {
+        std::cerr << "Warning: interference is not simulated offline" << std::endl;
+    }
+
+    OfflineConfig config;
+    config.global = options.global;
+    config.n_cpus = model._n_cores;
+    config.prediction_enabled = options.prediction_enabled;
+    config.headroom = options.budget_policy.headroom;
+    config.job_order = options.job_order;
+    config.late_policy = options.late_policy;
+    config.degrade_factor = degrade_factor;
+
+    std::vector<TaskLoad> loads = model.task_loads();
+    Partition partition = partition_tasks(loads, model._n_cores, options.fit);
+    if (not options.global and not partition.feasible) {
+        std::cerr << "Warning: tasks do not fit onto " << model._n_cores << " cores" << std::endl;
+    }
+
+    std::vector<OfflineJob> jobs;
+    jobs.reserve(model._jobs.size());
+    for (const Job &job: model._jobs) {
+        jobs.push_back(OfflineJob{model._task_loads[job._task].id, job._id,
+                                  job._submission_time.time_since_epoch() / 1ns,
+                                  job._execution_time / 1ns,
+                                  job._deadline.time_since_epoch() / 1ns});
+    }
+
+    std::vector<OfflineResult> results = simulate_offline(loads, partition, jobs, config);
+    std::stable_sort(results.begin(), results.end(),
+                     [](const OfflineResult &a, const OfflineResult &b) {
+                         return a.task_id < b.task_id;
+                     });
+    int64_t simulated = 0;
+    for (const OfflineResult &result: results) {
+        if (result.skipped) {
+            continue;
+        }
+        std::cout << "j " << result.id << " " << result.lateness << "\n";
+    }
+    for (const OfflineJob &job: jobs) {
+        simulated = std::max(simulated, job.deadline);
+    }
+    std::cout.flush();
 
-        if (job._submission_time - now > 1ms) {
-            //std::cerr << "sleep_until " << job._submission_time.time_since_epoch() / 1us << std::endl;
-            std::this_thread::sleep_until(job._submission_time - 1ms);
-            //std::cerr << "slept. Its now " << std::chrono::steady_clock::now().time_since_epoch() / 1us << std::endl;
+    duration wall = std::chrono::steady_clock::now() - wall_start;
+    std::cerr << "simulated " << simulated / 1'000'000 << " ms in " << wall / 1ms << " ms"
+              << std::endl;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    lttng_ust_tracepoint(sched_sim, start_main);
+
+    if (argc > 1 and std::string(argv[1]) == "sweep") {
+        return run_sweep(argc - 1, argv + 1);
+    }
+
+    Options options = parse_options(argc, argv);
+    if (not options.to_binary.empty() or not options.to_text.empty()) {
+        SimInput input = parse_sim_input(options.input);
+        if (not options.to_binary.empty()) {
+            write_binary_trace(options.to_binary, input);
         }
-        /* busy wait if next spawn is in future */
-        while (job._submission_time > now) {
-            now = std::chrono::steady_clock::now();
+        if (not options.to_text.empty()) {
+            write_text_trace(options.to_text, input);
         }
+        return 0;
+    }
+    if (options.offline) {
+        /* no real-time privileges or dedicated cpus needed */
+        return run_offline(options);
+    }
+    /* before the spawner pins itself below */
+    std::vector<unsigned> cpuset = cpuset_cpus();
+
+    /* the tasks get the cpus the spawner leaves them, unless they would run short of cores */
+    std::vector<unsigned> task_cpus;
+    std::copy_if(cpuset.begin(), cpuset.end(), std::back_inserter(task_cpus),
+                 [&options](unsigned cpu) {
+                     return options.colocate_spawners
+                            or std::find(options.spawner_cpus.begin(), options.spawner_cpus.end(),
+                                         cpu) == options.spawner_cpus.end();
+                 });
+
+    /* threads pin themselves, so they can be started on the side while the input is read */
+    std::unique_ptr<TaskThreadPools> pools;
+    if (options.task_pool) {
+        pools = std::make_unique<TaskThreadPools>();
+        pools->preconfigure(task_cpus, options.task_pool_prestart);
+    }
 
-        /* spawn job */
-        SimTask *task = model._tasks[job._task_id];
-        lttng_ust_tracepoint(sched_sim, job_spawn, task->id(), job._id, (job._deadline - now.time_since_epoch()).time_since_epoch() / 1ns);
+    /* also before pinning, so large inputs are sorted on all cpus */
+    std::unique_ptr<JobStream> stream;
+    Model model;
+    if (options.stream) {
+        stream = std::make_unique<JobStream>(options.input);
+        model = model_from(stream->header(), options.prediction_enabled);
+    } else {
+        model = parse_input(options.input, options.prediction_enabled);
+    }
 
-        task->add_job(job);
-        task->sem().release();
+    /* put the job spawning onto its own CPU */
+    become_spawner({options.spawner_cpus.front()});
+
+    if (options.n_cores > 0) {
+        model._n_cores = options.n_cores;
+    }
+    if (task_cpus.size() < static_cast<std::size_t>(model._n_cores)) {
+        task_cpus = cpuset;
+    }
+
+    if (options.global) {
+        GlobalAdmission admission = admit_global(model.task_loads(), cpuset.size(),
+                                                  model._prediction_enabled);
+        if (not admission.admitted) {
+            std::cerr << "Admission failed: utilization " << admission.utilization
+                      << " exceeds the root domain's limit of " << admission.limit << " on "
+                      << cpuset.size() << " cpus" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        model.create_global_tasks(cpuset, pools.get());
+    } else {
+        /* folding cores onto each other would undo the partitioner's capacity check */
+        if (task_cpus.size() < static_cast<std::size_t>(model._n_cores)) {
+            std::cerr << "cannot partition onto " << model._n_cores << " cores with only "
+                      << task_cpus.size() << " cpus available" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        Partition partition = partition_tasks(model.task_loads(), model._n_cores, options.fit);
+        if (not partition.feasible) {
+            std::cerr << "Warning: tasks do not fit onto " << model._n_cores
+                      << " cores. Core loads:";
+            for (double u: partition.utilization) {
+                std::cerr << " " << u;
+            }
+            std::cerr << std::endl;
+        }
+        model.create_tasks(partition, task_cpus, pools.get());
+    }
+
+    /* lateness in ns by task and job id, written by the task threads as jobs finish. Skipped
+     * jobs stay not_run and are left out like --offline does */
+    constexpr int64_t not_run = std::numeric_limits<int64_t>::min();
+    std::map<int, std::vector<int64_t>> lateness;
+    if (options.report_lateness) {
+        for (const Job &job: model._jobs) {
+            std::vector<int64_t> &task_lateness = lateness[model._task_loads[job._task].id];
+            task_lateness.resize(std::max<std::size_t>(task_lateness.size(), job._id + 1),
+                                 not_run);
+        }
+    }
+
+    for (uint32_t i = 0; i < model._tasks.size(); ++i) {
+        SimTask *task = model._tasks[i];
+        task->set_budget_policy(options.budget_policy);
+        task->set_job_order(options.job_order);
+        task->set_late_policy(options.late_policy, RunDegraded{model._kernels[i].get()});
+        if (options.report_lateness) {
+            task->set_completion_callback(RecordLateness{&lateness[task->id()]});
+        }
+    }
+
+    lttng_ust_tracepoint(sched_sim, input_parsed);
+
+    std::unique_ptr<Interference> interference;
+    if (not model._interference.empty()) {
+        interference = std::make_unique<Interference>(model._interference);
+    }
+
+    /* every task runs on its cpus with its deadline parameters, so jobs can start right away.
+     * Pooled tasks are only waited for if they have a job in the first release. The others take
+     * their thread once the spawner adds their first job, and set up while that job waits */
+    std::vector<bool> wait_for = options.task_pool ? model.first_released()
+                                                   : std::vector<bool>(model._tasks.size(), true);
+    duration startup(0);
+    std::size_t n_ready = 0;
+    for (uint32_t i = 0; i < model._tasks.size(); ++i) {
+        if (not wait_for[i]) {
+            continue;
+        }
+        model._tasks[i]->wait_until_ready();
+        startup = std::max(startup, model._tasks[i]->startup_time());
+        ++n_ready;
+    }
+    lttng_ust_tracepoint(sched_sim, waited_for_task_init, startup / 1ns);
+    std::cerr << n_ready << " tasks ready after " << startup / 1us << " us" << std::endl;
+
+    std::vector<Spawner> spawners;
+    if (options.n_spawners > 1 or options.colocate_spawners) {
+        spawners = shard_spawners(&model, options.n_spawners, options.colocate_spawners,
+                                  options.spawner_cpus);
+        spawn_sharded(&model, &spawners);
+    } else {
+        /* this thread is the only spawner. It calibrates before the start time is fixed */
+        spawners.resize(1);
+        Spawner &spawner = spawners.front();
+        spawner.cpus = {options.spawner_cpus.front()};
+        if (not stream) {
+            model.sort_jobs();
+            spawner.jobs = JobTable(model._jobs);
+            std::vector<Job>().swap(model._jobs);
+        }
+        spawner.timer = std::make_unique<SpawnTimer>();
+
+        time_point start = std::chrono::steady_clock::now();
+        model.set_start_time(start);
+
+        if (stream) {
+            stream->set_start_time(start);
+            spawn_jobs(&model, stream.get(), &spawner);
+        } else {
+            spawner.jobs.set_start_time(start);
+            spawn_jobs(&model, &spawner.jobs, &spawner);
+        }
     }
 
-    for (auto &[_, task]: model._tasks) {
+    for (SimTask *task: model._tasks) {
         task->sem().release();
         task->join();
     }
+    interference.reset();
+
+    print_spawners(spawners);
+    if (pools) {
+        std::cerr << "task threads: " << pools->threads() << " created, " << pools->reused()
+                  << " reused" << std::endl;
+    }
+
+    for (SimTask *task: model._tasks) {
+        BudgetCounters budget = task->budget_counters();
+        if (budget.updates or budget.skipped) {
+            std::cerr << "task " << task->id() << ": " << budget.updates << " budget updates, "
+                      << budget.skipped << " skipped, " << budget.syscalls_saved
+                      << " syscalls saved" << std::endl;
+        }
+        MigrationCounters migration = task->migration_counters();
+        if (migration.migrations) {
+            std::cerr << "task " << task->id() << ": " << migration.migrated_jobs << " of "
+                      << migration.jobs << " jobs migrated (" << migration.migrations
+                      << " migrations), " << migration.cost() / 1000 << " us extra runtime each"
+                      << std::endl;
+        }
+    }
+
+    for (auto &[_, task_lateness]: lateness) {
+        for (std::size_t id = 0; id < task_lateness.size(); ++id) {
+            if (task_lateness[id] == not_run) {
+                continue;
+            }
+            std::cout << "j " << id << " " << task_lateness[id] << "\n";
+        }
+    }
+    std::cout.flush();
 
     return 0;
 }
@@ -31,8 +31,10 @@ LTTNG_UST_TRACEPOINT_EVENT(
     sched_sim,
     waited_for_task_init,
     LTTNG_UST_TP_ARGS(
+        long, startup_arg
     ),
     LTTNG_UST_TP_FIELDS(
+        lttng_ust_field_integer(long, startup, startup_arg)
     )
 )
 
@@ -0,0 +1,516 @@
+#include "sim_input.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <tuple>
+
+#include "binary_trace.h"
+#include "mapped_file.h"
+
+using namespace std::chrono_literals;
+using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+
+
+/* Fields of the current line. Every error names the file and line, or the job record of a binary
+ * trace. */
+class LineParser {
+    const std::string &_path;
+    long _line = 0;
+    /* _line is the index of a binary job record */
+    bool _binary = false;
+    const char *_pos = nullptr;
+    const char *_end = nullptr;
+
+    void skip_blanks() {
+        while (this->_pos < this->_end and is_blank(*this->_pos)) {
+            ++this->_pos;
+        }
+    }
+
+  public:
+    explicit LineParser(const std::string &path)
+        : _path(path) {}
+
+    /* what separates fields, and is skipped before the type */
+    static bool is_blank(char c) {
+        return c == ' ' or c == '\t' or c == '\r';
+    }
+
+    void start_line(const char *begin, const char *end, long line) {
+        this->_line = line;
+        this->_binary = false;
+        this->_pos = begin;
+        this->_end = end;
+    }
+
+    /* errors from now on are about the index-th job record of a binary trace */
+    void start_binary_job(long index) {
+        this->start_line(nullptr, nullptr, index);
+        this->_binary = true;
+    }
+
+    [[noreturn]] void fail(const std::string &message) const {
+        std::cerr << "Parse error: " << this->_path;
+        if (this->_binary) {
+            std::cerr << ": job record " << this->_line;
+        } else {
+            std::cerr << ":" << this->_line;
+        }
+        std::cerr << ": " << message << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    /* first character of the line after leading blanks, 0 for empty lines */
+    char type() {
+        this->skip_blanks();
+        return this->_pos < this->_end ? *this->_pos++ : 0;
+    }
+
+    template <typename Int>
+    Int next(const char *what) {
+        this->skip_blanks();
+        Int value;
+        auto [end, error] = std::from_chars(this->_pos, this->_end, value);
+        if (error != std::errc()) {
+            this->fail(std::string("expected ") + what);
+        }
+        if (end < this->_end and not is_blank(*end)) {
+            this->fail(std::string("malformed ") + what);
+        }
+        this->_pos = end;
+        return value;
+    }
+
+    /* next key=value field, false at the end of the line */
+    bool next_field(std::string_view *key, std::string_view *value) {
+        this->skip_blanks();
+        if (this->_pos == this->_end) {
+            return false;
+        }
+        const char *begin = this->_pos;
+        while (this->_pos < this->_end and not is_blank(*this->_pos)) {
+            ++this->_pos;
+        }
+        std::string_view field(begin, this->_pos - begin);
+        std::size_t equals = field.find('=');
+        if (equals == std::string_view::npos or equals == 0) {
+            this->fail("malformed field: " + std::string(field));
+        }
+        *key = field.substr(0, equals);
+        *value = field.substr(equals + 1);
+        return true;
+    }
+
+    /* the next blank separated word */
+    std::string_view word(const char *what) {
+        this->skip_blanks();
+        const char *begin = this->_pos;
+        while (this->_pos < this->_end and not is_blank(*this->_pos)) {
+            ++this->_pos;
+        }
+        if (begin == this->_pos) {
+            this->fail(std::string("expected ") + what);
+        }
+        return std::string_view(begin, this->_pos - begin);
+    }
+
+    /* comma separated cpus and ranges of them, like 0,2-3 */
+    std::vector<unsigned> cpus(std::string_view list) const {
+        std::vector<unsigned> cpus;
+        const char *pos = list.data();
+        const char *end = list.data() + list.size();
+        while (pos < end) {
+            unsigned first, last;
+            auto [first_end, error] = std::from_chars(pos, end, first);
+            if (error != std::errc()) {
+                this->fail("malformed cpu list");
+            }
+            last = first;
+            pos = first_end;
+            if (pos < end and *pos == '-') {
+                auto [last_end, error] = std::from_chars(pos + 1, end, last);
+                if (error != std::errc() or last < first) {
+                    this->fail("malformed cpu list");
+                }
+                pos = last_end;
+            }
+            for (unsigned cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+            if (pos < end and *pos++ != ',') {
+                this->fail("malformed cpu list");
+            }
+        }
+        return cpus;
+    }
+
+    /* a field's value */
+    template <typename Int>
+    Int number(std::string_view value, const char *what) const {
+        Int number;
+        auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+        if (error != std::errc() or end != value.data() + value.size()) {
+            this->fail(std::string("malformed ") + what);
+        }
+        return number;
+    }
+
+    /* byte count with an optional binary K, M or G suffix */
+    std::size_t size(std::string_view value, const char *what) const {
+        std::size_t size;
+        auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), size);
+        if (error != std::errc()) {
+            this->fail(std::string("expected ") + what);
+        }
+        std::string_view suffix(end, value.data() + value.size() - end);
+        if (suffix == "K") {
+            size <<= 10;
+        } else if (suffix == "M") {
+            size <<= 20;
+        } else if (suffix == "G") {
+            size <<= 30;
+        } else if (not suffix.empty()) {
+            this->fail(std::string("malformed ") + what);
+        }
+        return size;
+    }
+
+    void expect_end() {
+        this->skip_blanks();
+        if (this->_pos != this->_end) {
+            this->fail("unexpected trailing input");
+        }
+    }
+};
+
+/* the job's task is left to the caller, which gets its id */
+static Job parse_job(LineParser *parser, int *task_id) {
+    int id = parser->next<int>("job id");
+    long execution_time = parser->next<long>("execution time");
+    long submission_time = parser->next<long>("submission time");
+    *task_id = parser->next<int>("task id");
+
+    long deadline = 0;
+    std::string_view key, value;
+    while (parser->next_field(&key, &value)) {
+        if (key == "deadline") {
+            deadline = parser->number<long>(value, "deadline");
+            if (deadline <= 0) {
+                parser->fail("deadline must be positive");
+            }
+        } else {
+            parser->fail("unknown job field: " + std::string(key));
+        }
+    }
+    return Job{id, 0, execution_time * 1us, time_point{deadline * 1us},
+               time_point{submission_time * 1us}};
+}
+
+/* key=value fields of the task go to input. Adds the task to task_index */
+static TaskLoad parse_task(LineParser *parser, SimInput *input,
+                           std::map<int, uint32_t> *task_index) {
+    int id = parser->next<int>("task id");
+    long execution_time = parser->next<long>("execution time");
+    long period = parser->next<long>("period");
+
+    if (not task_index->emplace(id, input->tasks.size()).second) {
+        parser->fail("duplicate task id: " + std::to_string(id));
+    }
+
+    TaskLoad task{id, execution_time * 1us, period * 1us};
+    std::string_view key, value;
+    while (parser->next_field(&key, &value)) {
+        if (key == "kernel") {
+            if (not parse_kernel_type(std::string(value), &input->kernels[id].type)) {
+                parser->fail("unknown kernel: " + std::string(value));
+            }
+        } else if (key == "footprint") {
+            input->kernels[id].footprint = parser->size(value, "footprint");
+        } else if (key == "deadline") {
+            task.deadline = parser->number<long>(value, "deadline") * 1us;
+            /* SCHED_DEADLINE wants runtime <= deadline <= period */
+            if (task.deadline <= 0us or task.deadline > task.period) {
+                parser->fail("deadline must be positive and at most the period");
+            }
+        } else if (key == "min_interarrival") {
+            task.min_interarrival = parser->number<long>(value, "minimum inter-arrival time")
+                                    * 1us;
+            if (task.min_interarrival < 0us) {
+                parser->fail("minimum inter-arrival time must not be negative");
+            }
+        } else {
+            parser->fail("unknown task field: " + std::string(key));
+        }
+    }
+    return task;
+}
+
+static InterferenceSpec parse_interference(LineParser *parser) {
+    InterferenceSpec spec;
+    spec.cpus = parser->cpus(parser->word("cpu list"));
+    std::string type(parser->word("interference type"));
+    if (not parse_interference_type(type, &spec.type)) {
+        parser->fail("unknown interference type: " + type);
+    }
+    spec.percent = parser->next<int>("intensity");
+    if (spec.percent < 1 or spec.percent > 100) {
+        parser->fail("intensity must be between 1 and 100 percent");
+    }
+
+    std::string_view key, value;
+    while (parser->next_field(&key, &value)) {
+        if (key == "footprint") {
+            spec.footprint = parser->size(value, "footprint");
+        } else {
+            parser->fail("unknown interference field: " + std::string(key));
+        }
+    }
+    return spec;
+}
+
+/* Reads a c, S or I record into input, tasks also into task_index. Returns the line's type: 0 for
+ * empty lines and comments, which are skipped, and 'j' for a job record, which is left to the
+ * caller right after the type. */
+static char parse_header_record(LineParser *parser, SimInput *input,
+                                std::map<int, uint32_t> *task_index) {
+    char type = parser->type();
+    switch (type) {
+        break; case 'c':
+            input->n_cores = parser->next<int>("core count");
+            if (input->n_cores < 1) {
+                parser->fail("core count must be positive");
+            }
+        break; case 'j':
+            return type;
+        break; case 'S':
+            input->tasks.push_back(parse_task(parser, input, task_index));
+        break; case 'I':
+            input->interference.push_back(parse_interference(parser));
+        break; case '#':
+            return 0;
+        break; case 0:
+            return 0;
+        break; default:
+            parser->fail(std::string("\"") + type + "\" is not a proper type");
+    }
+    parser->expect_end();
+    return type;
+}
+
+/* upper bound for the number of job records, so the job vector is allocated once. Leading
+ * blanks are skipped as LineParser::type does */
+static std::size_t count_job_lines(const char *begin, const char *end) {
+    std::size_t n = 0;
+    for (const char *line = begin; line < end;) {
+        while (line < end and LineParser::is_blank(*line)) {
+            ++line;
+        }
+        if (line < end and *line == 'j') {
+            ++n;
+        }
+        auto newline = static_cast<const char *>(std::memchr(line, '\n', end - line));
+        if (not newline) {
+            break;
+        }
+        line = newline + 1;
+    }
+    return n;
+}
+
+SimInput parse_sim_input(const std::string &path) {
+    MappedFile file(path);
+    if (is_binary_trace(file)) {
+        return read_binary_trace(file, path);
+    }
+
+    SimInput input;
+    input.jobs.reserve(count_job_lines(file.begin(), file.end()));
+
+    std::map<int, uint32_t> task_index;
+    /* jobs whose task comes later in the file: position, task id and line */
+    std::vector<std::tuple<std::size_t, int, long>> unresolved;
+
+    LineParser parser(path);
+    long line_number = 0;
+    for (const char *line = file.begin(); line < file.end();) {
+        auto newline = static_cast<const char *>(std::memchr(line, '\n', file.end() - line));
+        const char *line_end = newline ? newline : file.end();
+        parser.start_line(line, line_end, ++line_number);
+        line = line_end + 1;
+
+        if (parse_header_record(&parser, &input, &task_index) != 'j') {
+            continue;
+        }
+        int task_id;
+        input.jobs.push_back(parse_job(&parser, &task_id));
+        parser.expect_end();
+        auto task = task_index.find(task_id);
+        if (task != task_index.end()) {
+            input.jobs.back()._task = task->second;
+        } else {
+            unresolved.emplace_back(input.jobs.size() - 1, task_id, line_number);
+        }
+    }
+
+    for (auto [position, task_id, line]: unresolved) {
+        auto task = task_index.find(task_id);
+        if (task == task_index.end()) {
+            parser.start_line(nullptr, nullptr, line);
+            parser.fail("unresolvable task id: " + std::to_string(task_id));
+        }
+        input.jobs[position]._task = task->second;
+    }
+
+    return input;
+}
+
+JobTable::JobTable(std::span<const Job> jobs) {
+    this->_submission_time.reserve(jobs.size());
+    this->_task.reserve(jobs.size());
+    this->_id.reserve(jobs.size());
+    this->_execution_time.reserve(jobs.size());
+    this->_deadline.reserve(jobs.size());
+    for (const Job &job: jobs) {
+        this->push_back(job);
+    }
+}
+
+void JobTable::push_back(const Job &job) {
+    this->_submission_time.push_back(job._submission_time);
+    this->_task.push_back(job._task);
+    this->_id.push_back(job._id);
+    this->_execution_time.push_back(job._execution_time);
+    this->_deadline.push_back(job._deadline);
+}
+
+void JobTable::set_start_time(time_point start) {
+    for (std::size_t i = 0; i < this->size(); ++i) {
+        this->_submission_time[i] += start.time_since_epoch();
+        this->_deadline[i] += start.time_since_epoch();
+    }
+}
+
+std::span<const Job> JobTable::next_batch() {
+    std::size_t begin = this->_next;
+    if (begin == this->size()) {
+        return {};
+    }
+    std::size_t end = begin + 1;
+    while (end < this->size() and this->_submission_time[end] == this->_submission_time[begin]
+           and this->_task[end] == this->_task[begin]) {
+        ++end;
+    }
+    this->_next = end;
+
+    this->_batch.clear();
+    for (std::size_t i = begin; i < end; ++i) {
+        this->_batch.push_back(Job{this->_id[i], this->_task[i], this->_execution_time[i],
+                                   this->_deadline[i], this->_submission_time[i]});
+    }
+    return this->_batch;
+}
+
+JobStream::JobStream(const std::string &path)
+    : _path(path), _file(path, false), _pos(_file.begin()) {
+    this->_binary = is_binary_trace(this->_file);
+    if (this->_binary) {
+        this->_pos = read_binary_trace_header(this->_file, path, &this->_header,
+                                              &this->_n_binary_jobs);
+    } else {
+        /* header records up to the first job, whose line read_job starts with */
+        LineParser parser(path);
+        while (this->_pos < this->_file.end()) {
+            auto newline = static_cast<const char *>(
+                               std::memchr(this->_pos, '\n', this->_file.end() - this->_pos));
+            const char *line_end = newline ? newline : this->_file.end();
+            parser.start_line(this->_pos, line_end, this->_line + 1);
+            if (parse_header_record(&parser, &this->_header, &this->_task_index) == 'j') {
+                break;
+            }
+            ++this->_line;
+            this->_pos = line_end + 1;
+        }
+    }
+
+    this->_numbering.resize(this->_header.tasks.size());
+}
+
+bool JobStream::read_job(Job *job) {
+    LineParser parser(this->_path);
+    if (this->_binary) {
+        if (this->_n_binary_jobs == 0) {
+            return false;
+        }
+        --this->_n_binary_jobs;
+        parser.start_binary_job(this->_line++);
+        *job = read_binary_job(this->_pos, this->_header, this->_path);
+        this->_pos += binary_job_size;
+    } else {
+        while (true) {
+            if (this->_pos >= this->_file.end()) {
+                return false;
+            }
+            auto newline = static_cast<const char *>(
+                               std::memchr(this->_pos, '\n', this->_file.end() - this->_pos));
+            const char *line_end = newline ? newline : this->_file.end();
+            parser.start_line(this->_pos, line_end, ++this->_line);
+            this->_pos = line_end + 1;
+
+            char type = parser.type();
+            if (type == 0 or type == '#') {
+                continue;
+            }
+            if (type != 'j') {
+                parser.fail("streamed input needs all c, S and I records before the first job");
+            }
+            int task_id;
+            *job = parse_job(&parser, &task_id);
+            parser.expect_end();
+            auto task = this->_task_index.find(task_id);
+            if (task == this->_task_index.end()) {
+                parser.fail("unresolvable task id: " + std::to_string(task_id));
+            }
+            job->_task = task->second;
+            break;
+        }
+    }
+
+    this->_numbering[job->_task].number(this->_header.tasks[job->_task], job);
+    job->_deadline += this->_offset;
+    job->_submission_time += this->_offset;
+    if (job->_submission_time < this->_last_submission) {
+        parser.fail("jobs are not sorted by submission time, which streaming needs");
+    }
+    this->_last_submission = job->_submission_time;
+
+    if (static_cast<std::size_t>(this->_pos - this->_file.begin()) >= this->_next_release) {
+        this->_file.release_until(this->_pos);
+        this->_next_release += stream_release_interval;
+    }
+    return true;
+}
+
+std::span<const Job> JobStream::next_batch() {
+    this->_batch.clear();
+    if (not this->_has_pending and not this->read_job(&this->_pending)) {
+        return {};
+    }
+    this->_batch.push_back(this->_pending);
+    this->_has_pending = false;
+
+    Job job;
+    while (this->read_job(&job)) {
+        if (job._submission_time != this->_batch.front()._submission_time
+            or job._task != this->_batch.front()._task) {
+            this->_pending = job;
+            this->_has_pending = true;
+            break;
+        }
+        this->_batch.push_back(job);
+    }
+    return this->_batch;
+}
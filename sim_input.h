@@ -0,0 +1,180 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "interference.h"
+#include "kernels.h"
+#include "mapped_file.h"
+#include "partition.h"
+
+
+/* 32 bytes, two jobs to a cache line */
+struct Job {
+    int _id;
+    /* position of the job's task in SimInput::tasks */
+    uint32_t _task;
+    std::chrono::nanoseconds _execution_time;
+    std::chrono::time_point<std::chrono::steady_clock> _deadline;
+    std::chrono::time_point<std::chrono::steady_clock> _submission_time;
+};
+
+/* Numbers the jobs of one task and gives them their absolute deadlines, fed one job after the
+ * other in input order. A job is released when it is submitted, for sporadic tasks not before the
+ * minimum inter-arrival time after the previous release. Its deadline is its relative deadline
+ * after the release.
+ *
+ * Until then _deadline of a parsed job holds the relative deadline of its own record, or zero for
+ * the task's. */
+class JobNumbering {
+    using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+
+    int _next_id = 0;
+    time_point _last_release;
+
+  public:
+    /* when the next job, submitted at submission, is released */
+    time_point release(const TaskLoad &task, time_point submission) const {
+        if (this->_next_id and submission < this->_last_release + task.min_interarrival) {
+            return this->_last_release + task.min_interarrival;
+        }
+        return submission;
+    }
+
+    void number(const TaskLoad &task, Job *job) {
+        std::chrono::nanoseconds deadline = job->_deadline.time_since_epoch();
+        this->_last_release = this->release(task, job->_submission_time);
+        job->_id = this->_next_id++;
+        job->_deadline = this->_last_release
+                         + (deadline.count() ? deadline : task.relative_deadline());
+    }
+};
+
+/* Contents of a sched_sim input file. One record per line, the first character gives its type:
+ *   c <n_cores>
+ *   S <task id> <execution time us> <period us> [key=value...]
+ *   j <job id> <execution time us> <submission time us> <task id> [key=value...]
+ *   I <cpus> memory|cache|syscall <percent> [key=value...]
+ * Lines starting with # and empty lines are ignored. Jobs keep the order of the file and get no
+ * deadlines yet, see JobNumbering. Task ids are unique, jobs refer to their task by its position
+ * in the file.
+ *
+ * Optional task fields:
+ *   kernel=spin|alu|memory|cache|branchy   what the task's jobs do, see KernelType
+ *   footprint=<bytes>[K|M|G]               buffer size of the memory and cache kernels
+ *   deadline=<us>                          relative deadline, at most the period. Defaults to it
+ *   min_interarrival=<us>                  least time between the releases of two jobs
+ *
+ * Optional job fields:
+ *   deadline=<us>                          relative deadline of this job instead of the task's
+ *
+ * I records add a background thread to each of the cpus, a comma separated list of cpus and
+ * ranges like 0,2-3, that is busy for percent of the time. See InterferenceType. It takes a
+ * footprint field like tasks do. */
+struct SimInput {
+    int n_cores = 1;
+    std::vector<TaskLoad> tasks;
+    /* task id -> kernel, for the tasks that name one */
+    std::map<int, KernelSpec> kernels;
+    std::vector<InterferenceSpec> interference;
+    std::vector<Job> jobs;
+    /* jobs are sorted by submission time and already carry their ids and absolute deadlines, as
+     * read from a binary trace */
+    bool numbered = false;
+};
+
+/* Maps the file and scans it once. Malformed records end the program with the file name and line
+ * number. Binary traces (see binary_trace.h) are recognised and read as well. */
+SimInput parse_sim_input(const std::string &path);
+
+/* Jobs in spawn order, one batch at a time. A batch holds the jobs of one task that are submitted
+ * at the same time. */
+class JobSource {
+  public:
+    virtual ~JobSource() = default;
+
+    /* empty once all jobs are through. Valid until the next call */
+    virtual std::span<const Job> next_batch() = 0;
+};
+
+/* Jobs that are all in memory, sorted already, held as a structure of arrays. Finding the next
+ * batch only reads submission times and task indices, 12 bytes per job, the rest of a job is
+ * read once its batch is handed out. */
+class JobTable : public JobSource {
+    using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+
+    std::vector<time_point> _submission_time;
+    std::vector<uint32_t> _task;
+    std::vector<int> _id;
+    std::vector<std::chrono::nanoseconds> _execution_time;
+    std::vector<time_point> _deadline;
+
+    std::size_t _next = 0;
+    std::vector<Job> _batch;
+
+  public:
+    JobTable() = default;
+    explicit JobTable(std::span<const Job> jobs);
+
+    void push_back(const Job &job);
+
+    std::size_t size() const {
+        return this->_id.size();
+    }
+
+    /* move all jobs from times relative to start to absolute ones */
+    void set_start_time(time_point start);
+
+    std::span<const Job> next_batch() override;
+};
+
+/* Jobs of a text or binary input that is sorted by submission time already, read while they are
+ * spawned. Ids and deadlines come from a JobNumbering per task, so nothing but the current batch
+ * is kept in memory and pages of the file are dropped once they are read. All c, S and I records
+ * of text input have to come before the first job. Unsorted jobs end the program with their line
+ * number. */
+class JobStream : public JobSource {
+    std::string _path;
+    MappedFile _file;
+    SimInput _header;
+    bool _binary;
+    const char *_pos;
+    long _line = 0;
+    uint64_t _n_binary_jobs = 0;
+    /* read pages are dropped every stream_release_interval bytes */
+    static constexpr std::size_t stream_release_interval = 16 << 20;
+    std::size_t _next_release = stream_release_interval;
+
+    /* task id -> index, for text input */
+    std::map<int, uint32_t> _task_index;
+    /* by task index */
+    std::vector<JobNumbering> _numbering;
+    std::chrono::nanoseconds _offset = std::chrono::nanoseconds(0);
+    std::chrono::time_point<std::chrono::steady_clock> _last_submission;
+
+    Job _pending;
+    bool _has_pending = false;
+    std::vector<Job> _batch;
+
+    bool read_job(Job *job);
+
+  public:
+    explicit JobStream(const std::string &path);
+
+    /* core count and tasks, without jobs */
+    const SimInput &header() const {
+        return this->_header;
+    }
+
+    /* shift all times of jobs not read yet, like Model::set_start_time */
+    void set_start_time(std::chrono::time_point<std::chrono::steady_clock> start) {
+        this->_offset = start.time_since_epoch();
+    }
+
+    std::span<const Job> next_batch() override;
+};
@@ -0,0 +1,123 @@
+#include "spawn_timer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include <sys/prctl.h>
+
+using namespace std::chrono_literals;
+using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+using duration = std::chrono::nanoseconds;
+
+
+SpawnTimer::SpawnTimer(int n_calibration) {
+    /* timer slack only applies to normal threads, but the spawner may run as one */
+    prctl(PR_SET_TIMERSLACK, 1UL);
+
+    this->_slack = min_slack;
+    for (int i = 0; i < n_calibration; ++i) {
+        this->adapt(sleep_until(std::chrono::steady_clock::now() + 100us));
+    }
+    this->_late_wakeups = 0;
+}
+
+/* steady_clock is CLOCK_MONOTONIC, so its time points can be handed to the kernel as they are */
+duration SpawnTimer::sleep_until(time_point wakeup) {
+    auto since_epoch = wakeup.time_since_epoch();
+    struct timespec ts;
+    ts.tv_sec = since_epoch / 1s;
+    ts.tv_nsec = (since_epoch % 1s) / 1ns;
+    int error;
+    while ((error = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr)) == EINTR) {
+    }
+    if (error) {
+        errno = error;
+        perror("clock_nanosleep");
+        exit(-1);
+    }
+    return std::chrono::steady_clock::now() - wakeup;
+}
+
+void SpawnTimer::adapt(duration latency) {
+    /* a quarter of the latency on top covers its usual spread */
+    duration wanted = std::clamp(latency + latency / 4, min_slack, max_slack);
+    if (latency > this->_slack) {
+        ++this->_late_wakeups;
+    }
+    /* rises faster than it falls, but a single preempted sleep must not make the spawner spin
+     * for a long time afterwards */
+    if (wanted > this->_slack) {
+        this->_slack += (std::min(wanted, 2 * this->_slack) - this->_slack) / 4;
+    } else {
+        this->_slack -= (this->_slack - wanted) / 32;
+    }
+}
+
+time_point SpawnTimer::wait_until(time_point target) {
+    time_point now = std::chrono::steady_clock::now();
+    if (target - now > this->_slack) {
+        this->adapt(sleep_until(target - this->_slack));
+        now = std::chrono::steady_clock::now();
+    }
+    while (now < target) {
+        now = std::chrono::steady_clock::now();
+    }
+    return now;
+}
+
+int JitterHistogram::bucket(duration jitter) {
+    int i = 0;
+    for (duration bound = 1us; i < n_buckets and jitter >= bound; bound *= 2) {
+        ++i;
+    }
+    return i;
+}
+
+void JitterHistogram::add(duration jitter) {
+    ++this->_counts[bucket(jitter)];
+    ++this->_count;
+    this->_max = std::max(this->_max, jitter);
+}
+
+void JitterHistogram::merge(const JitterHistogram &other) {
+    for (int i = 0; i <= n_buckets; ++i) {
+        this->_counts[i] += other._counts[i];
+    }
+    this->_count += other._count;
+    this->_max = std::max(this->_max, other._max);
+}
+
+duration JitterHistogram::percentile(double q) const {
+    long seen = 0;
+    duration bound = 1us;
+    for (int i = 0; i < n_buckets; ++i, bound *= 2) {
+        seen += this->_counts[i];
+        if (seen >= q * this->_count) {
+            return std::min(bound, this->_max);
+        }
+    }
+    return this->_max;
+}
+
+void JitterHistogram::print(std::ostream &out) const {
+    out << "spawn jitter: " << this->_count << " jobs, p50 <= " << this->percentile(0.5) / 1us
+        << " us, p99 <= " << this->percentile(0.99) / 1us << " us, max "
+        << this->_max / 1us << " us" << std::endl;
+    duration lower = 0us;
+    duration upper = 1us;
+    for (int i = 0; i <= n_buckets; ++i, lower = upper, upper *= 2) {
+        if (not this->_counts[i]) {
+            continue;
+        }
+        out << "  " << lower / 1us << " - ";
+        if (i < n_buckets) {
+            out << upper / 1us << " us: ";
+        } else {
+            out << "... us: ";
+        }
+        out << this->_counts[i] << std::endl;
+    }
+}
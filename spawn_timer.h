@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+
+
+/* Waits for absolute points in time with little jitter and little CPU.
+ *
+ * The thread sleeps with clock_nanosleep(TIMER_ABSTIME) until slack before the target and spins
+ * only for the rest. The slack follows the observed wakeup latency plus a margin: late wakeups
+ * raise it quickly, wakeups with room to spare let it decay slowly. It starts from a short
+ * calibration. */
+class SpawnTimer {
+    using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+    using duration = std::chrono::nanoseconds;
+
+    static constexpr duration min_slack = std::chrono::microseconds(2);
+    static constexpr duration max_slack = std::chrono::milliseconds(1);
+
+    duration _slack = std::chrono::microseconds(50);
+    long _late_wakeups = 0;
+
+    /* sleep until wakeup, returns how much later the thread actually woke up */
+    static duration sleep_until(time_point wakeup);
+
+    void adapt(duration latency);
+
+  public:
+    /* measures the wakeup latency n times to pick the initial slack */
+    explicit SpawnTimer(int n_calibration = 64);
+
+    /* returns at target or as soon as possible after it, with the time it returned */
+    time_point wait_until(time_point target);
+
+    duration slack() const {
+        return this->_slack;
+    }
+
+    /* sleeps that woke up after their target, so the spin could not absorb them */
+    long late_wakeups() const {
+        return this->_late_wakeups;
+    }
+};
+
+/* Histogram of how far after their submission time jobs were spawned. Buckets double in width
+ * from 1 us up. */
+class JitterHistogram {
+    static constexpr int n_buckets = 16;
+
+    long _counts[n_buckets + 1] = {};
+    long _count = 0;
+    std::chrono::nanoseconds _max = std::chrono::nanoseconds(0);
+
+    static int bucket(std::chrono::nanoseconds jitter);
+
+  public:
+    void add(std::chrono::nanoseconds jitter);
+
+    /* add all jitters other saw */
+    void merge(const JitterHistogram &other);
+
+    /* upper bound of the bucket the q-quantile falls into */
+    std::chrono::nanoseconds percentile(double q) const;
+
+    void print(std::ostream &out) const;
+};
@@ -0,0 +1,340 @@
+#include "sweep.h"
+
+#include <getopt.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "partition.h"
+#include "sim_input.h"
+
+
+/* one point of the grid */
+struct SweepRun {
+    std::string input;
+    int n_cores;
+    bool prediction_enabled;
+    double headroom;
+    bool dedicated_spawner;
+
+    std::vector<unsigned> cpus;
+    pid_t pid = -1;
+    /* the run's stdout */
+    FILE *output = nullptr;
+    std::chrono::steady_clock::time_point start;
+    double wall_seconds = 0;
+    int status = 0;
+};
+
+struct SweepOptions {
+    /* 0 is the input's own core count */
+    std::vector<int> cores = {0};
+    std::vector<bool> prediction = {false};
+    std::vector<double> headroom = {0};
+    std::vector<bool> dedicated_spawner = {true};
+    bool offline = false;
+    unsigned max_parallel = 0;
+    std::vector<std::string> inputs;
+    /* passed on to every run */
+    std::vector<std::string> run_options;
+};
+
+static void sweep_usage() {
+    std::cerr << "usage: sched_sim sweep [grid options] INPUT_FILE... [-- OPTIONS]\n"
+              << "  OPTIONS                         sched_sim options for every run\n"
+              << "grid, each a comma separated list of values:\n"
+              << "  --cores=N,...                   core counts (default: the input's)\n"
+              << "  --prediction=0|1,...            prediction off/on (default 0)\n"
+              << "  --headroom=FRAC,...             budget headroom (default 0)\n"
+              << "  --spawner=dedicated|shared,...  spawner on a cpu of its own or on the\n"
+              << "                                  first task cpu (default dedicated)\n"
+              << "execution:\n"
+              << "  --offline                       simulate in virtual time, one cpu per run\n"
+              << "  --parallel=N                    at most N runs at a time (default: as many\n"
+              << "                                  as the cpuset fits)"
+              << std::endl;
+}
+
+static std::vector<std::string> split_list(const std::string &list) {
+    std::vector<std::string> values;
+    std::stringstream ss(list);
+    std::string value;
+    while (std::getline(ss, value, ',')) {
+        values.push_back(value);
+    }
+    if (values.empty()) {
+        std::cerr << "empty list of values" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return values;
+}
+
+static SweepOptions parse_sweep_options(int argc, char *argv[]) {
+    enum {
+        CORES = 256,
+        PREDICTION,
+        HEADROOM,
+        SPAWNER,
+        OFFLINE,
+        PARALLEL,
+    };
+    static const struct option long_options[] = {
+        {"cores", required_argument, nullptr, CORES},
+        {"prediction", required_argument, nullptr, PREDICTION},
+        {"headroom", required_argument, nullptr, HEADROOM},
+        {"spawner", required_argument, nullptr, SPAWNER},
+        {"offline", no_argument, nullptr, OFFLINE},
+        {"parallel", required_argument, nullptr, PARALLEL},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    SweepOptions options;
+    /* everything after -- belongs to the runs */
+    int n_sweep_args = argc;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--") == 0) {
+            n_sweep_args = i;
+            options.run_options.assign(argv + i + 1, argv + argc);
+            break;
+        }
+    }
+
+    int opt;
+    while ((opt = getopt_long(n_sweep_args, argv, "h", long_options, nullptr)) != -1) {
+        switch (opt) {
+            break; case CORES:
+                options.cores.clear();
+                for (const std::string &value: split_list(optarg)) {
+                    options.cores.push_back(std::stoi(value));
+                }
+            break; case PREDICTION:
+                options.prediction.clear();
+                for (const std::string &value: split_list(optarg)) {
+                    options.prediction.push_back(value == "1");
+                }
+            break; case HEADROOM:
+                options.headroom.clear();
+                for (const std::string &value: split_list(optarg)) {
+                    options.headroom.push_back(std::stod(value));
+                }
+            break; case SPAWNER:
+                options.dedicated_spawner.clear();
+                for (const std::string &value: split_list(optarg)) {
+                    if (value != "dedicated" and value != "shared") {
+                        std::cerr << "unknown spawner placement: " << value << std::endl;
+                        exit(EXIT_FAILURE);
+                    }
+                    options.dedicated_spawner.push_back(value == "dedicated");
+                }
+            break; case OFFLINE:
+                options.offline = true;
+            break; case PARALLEL:
+                options.max_parallel = std::stoul(optarg);
+            break; case 'h':
+                sweep_usage();
+                exit(EXIT_SUCCESS);
+            break; default:
+                sweep_usage();
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    options.inputs.assign(argv + optind, argv + n_sweep_args);
+    if (options.inputs.empty()) {
+        std::cerr << "no input file provided. Exiting." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return options;
+}
+
+/* core count of the input, read the way sched_sim reads it. Only the header is parsed, for text
+ * input up to the first job */
+static int input_cores(const std::string &path) {
+    return JobStream(path).header().n_cores;
+}
+
+static std::vector<SweepRun> build_grid(const SweepOptions &options) {
+    std::vector<SweepRun> runs;
+    for (const std::string &input: options.inputs) {
+        int own_cores = input_cores(input);
+        for (int n_cores: options.cores) {
+            for (bool prediction_enabled: options.prediction) {
+                for (double headroom: options.headroom) {
+                    for (bool dedicated_spawner: options.dedicated_spawner) {
+                        SweepRun run;
+                        run.input = input;
+                        run.n_cores = n_cores > 0 ? n_cores : own_cores;
+                        run.prediction_enabled = prediction_enabled;
+                        run.headroom = headroom;
+                        run.dedicated_spawner = dedicated_spawner;
+                        runs.push_back(run);
+                    }
+                }
+            }
+        }
+    }
+    return runs;
+}
+
+static std::size_t cpus_needed(const SweepRun &run, const SweepOptions &options) {
+    if (options.offline) {
+        return 1;
+    }
+    return run.n_cores + (run.dedicated_spawner ? 1 : 0);
+}
+
+static void start_run(SweepRun *run, const SweepOptions &options) {
+    std::vector<std::string> args = {"sched_sim"};
+    args.push_back(options.offline ? "--offline" : "--lateness");
+    args.push_back("--cores=" + std::to_string(run->n_cores));
+    args.push_back("--budget-headroom=" + std::to_string(run->headroom));
+    args.push_back("--spawner-cpu=" + std::to_string(run->cpus.front()));
+    args.insert(args.end(), options.run_options.begin(), options.run_options.end());
+    args.push_back(run->input);
+    args.push_back(run->prediction_enabled ? "1" : "0");
+
+    run->output = tmpfile();
+    if (not run->output) {
+        perror("tmpfile");
+        exit(-1);
+    }
+    run->start = std::chrono::steady_clock::now();
+
+    /* nothing buffered may end up in the child's output as well */
+    std::cout.flush();
+    fflush(stdout);
+    run->pid = fork();
+    if (run->pid < 0) {
+        perror("fork");
+        exit(-1);
+    }
+    if (run->pid > 0) {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned cpu: run->cpus) {
+        CPU_SET(cpu, &set);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+        perror("sched_setaffinity");
+        _exit(127);
+    }
+    if (dup2(fileno(run->output), STDOUT_FILENO) < 0) {
+        perror("dup2");
+        _exit(127);
+    }
+
+    std::vector<char *> argv;
+    for (std::string &arg: args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+    execv("/proc/self/exe", argv.data());
+    perror("execv");
+    _exit(127);
+}
+
+/* one row of the summary table from the "j <job> <lateness>" lines of a run */
+static void print_row(SweepRun *run) {
+    std::vector<long> lateness;
+    rewind(run->output);
+    char line[256];
+    while (fgets(line, sizeof(line), run->output)) {
+        long id;
+        long job_lateness;
+        if (sscanf(line, "j %ld %ld", &id, &job_lateness) == 2) {
+            lateness.push_back(job_lateness);
+        }
+    }
+    fclose(run->output);
+
+    std::sort(lateness.begin(), lateness.end());
+    long late = lateness.end() - std::upper_bound(lateness.begin(), lateness.end(), 0l);
+    double mean = 0;
+    for (long l: lateness) {
+        mean += static_cast<double>(l) / lateness.size();
+    }
+    double p99 = lateness.empty() ? 0 : lateness[(lateness.size() - 1) * 99 / 100];
+    double max = lateness.empty() ? 0 : lateness.back();
+
+    int exit_code = WIFEXITED(run->status) ? WEXITSTATUS(run->status) : -1;
+    printf("%-24s %5d %4d %8.3f %-9s %4d %9zu %9ld %7.2f %11.1f %11.1f %11.1f %8.2f\n",
+           run->input.c_str(), run->n_cores, run->prediction_enabled, run->headroom,
+           run->dedicated_spawner ? "dedicated" : "shared", exit_code, lateness.size(), late,
+           lateness.empty() ? 0 : 100.0 * late / lateness.size(), mean / 1000, p99 / 1000,
+           max / 1000, run->wall_seconds);
+}
+
+int run_sweep(int argc, char *argv[]) {
+    SweepOptions options = parse_sweep_options(argc, argv);
+    std::vector<SweepRun> runs = build_grid(options);
+
+    std::vector<unsigned> free_cpus = cpuset_cpus();
+    std::size_t n_cpus = free_cpus.size();
+
+    std::size_t next = 0;
+    std::size_t n_running = 0;
+    while (next < runs.size() or n_running > 0) {
+        /* start runs in grid order while their cpus are free */
+        while (next < runs.size()
+               and (options.max_parallel == 0 or n_running < options.max_parallel)) {
+            SweepRun &run = runs[next];
+            /* runs bigger than the machine get all of it */
+            std::size_t needed = std::min(cpus_needed(run, options), n_cpus);
+            if (needed > free_cpus.size()) {
+                break;
+            }
+            run.cpus.assign(free_cpus.begin(), free_cpus.begin() + needed);
+            free_cpus.erase(free_cpus.begin(), free_cpus.begin() + needed);
+            start_run(&run, options);
+            std::cerr << "[" << next + 1 << "/" << runs.size() << "] " << run.input << " on "
+                      << run.cpus.size() << " cpus from " << run.cpus.front() << std::endl;
+            ++next;
+            ++n_running;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            perror("wait");
+            exit(-1);
+        }
+        auto run = std::find_if(runs.begin(), runs.end(),
+                                [pid](const SweepRun &r) { return r.pid == pid; });
+        if (run == runs.end()) {
+            continue;
+        }
+        run->status = status;
+        run->wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                          - run->start).count();
+        free_cpus.insert(free_cpus.end(), run->cpus.begin(), run->cpus.end());
+        std::sort(free_cpus.begin(), free_cpus.end());
+        --n_running;
+    }
+
+    printf("%-24s %5s %4s %8s %-9s %4s %9s %9s %7s %11s %11s %11s %8s\n", "input", "cores",
+           "pred", "headroom", "spawner", "exit", "jobs", "late", "late%", "mean_us", "p99_us",
+           "max_us", "wall_s");
+    int failed = 0;
+    for (SweepRun &run: runs) {
+        print_row(&run);
+        if (not WIFEXITED(run.status) or WEXITSTATUS(run.status) != 0) {
+            ++failed;
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
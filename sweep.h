@@ -0,0 +1,10 @@
+#pragma once
+
+
+/* sched_sim sweep: run sched_sim for every combination of a parameter grid and input files.
+ *
+ * Every run gets a disjoint set of cpus of the cpuset the sweep was started in. As many runs as
+ * fit execute side by side, each one pinned to its set with its spawner on the first cpu of it.
+ * Runs report their jobs' lateness on stdout (--lateness, or --offline), which the sweep reduces
+ * to one row per run of a single table. Returns the exit code. argv[0] is "sweep". */
+int run_sweep(int argc, char *argv[]);
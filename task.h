@@ -1,17 +1,32 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <functional>
+#include <condition_variable>
 #include <fstream>
 #include <iostream>
-#include <semaphore>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <thread>
-#include <queue>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <sched.h>
+#include <sys/eventfd.h>
 
 #include <predictor/predictor.h>
 
+#include "alloc_counter.h"
+#include "futex_semaphore.h"
+#include "job_queue.h"
 #include "rt.h"
+#include "runtime_stats.h"
 #include "task_lib_tracepoint.h"
+#include "task_pool.h"
 
 
 using namespace std::chrono_literals;
@@ -20,31 +35,254 @@ using duration = typename std::chrono::nanoseconds;
 
 time_point thread_now();
 
+/* How the task thread waits for its next job. Spinning keeps the wakeup latency off the critical
+ * path but burns the task's budget, so it only happens if the next job is expected within the spin
+ * window: for periodic tasks one period after the last job arrived. */
+struct WakeupPolicy {
+    /* longest time to spin before sleeping in the kernel. 0 sleeps right away */
+    duration spin = duration(0);
+};
+
+
+/* When a new runtime prediction gets applied with sched_setattr. By default every change is.
+ * An update is skipped if it changes the runtime by less than either threshold, so it has to pass
+ * both to be applied, or if it comes sooner than min_interval after the last one. With
+ * lower_lazily, raising the runtime ignores min_interval, so only decreases wait. */
+struct BudgetPolicy {
+    /* fraction of the current runtime */
+    double relative_threshold = 0;
+    duration absolute_threshold = duration(0);
+    duration min_interval = duration(0);
+    bool lower_lazily = false;
+    /* reserve this fraction on top of every prediction */
+    double headroom = 0;
+};
+
+/* What the budget policy did so far */
+struct BudgetCounters {
+    long updates = 0;
+    long skipped = 0;
+    /* sched_getattr/sched_setattr calls not made compared to updating on every job */
+    long syscalls_saved = 0;
+};
+
+/* Where a task's jobs ran. Matters once a task may run on more than one CPU */
+struct MigrationCounters {
+    long jobs = 0;
+    /* jobs that started on another CPU than the previous job ended on, or moved while running */
+    long migrated_jobs = 0;
+    long migrations = 0;
+    /* runtime sums in ns, split by whether the job migrated */
+    double migrated_runtime = 0;
+    double local_runtime = 0;
+
+    /* mean extra runtime of a migrated job in ns */
+    double cost() const {
+        long local_jobs = this->jobs - this->migrated_jobs;
+        if (not this->migrated_jobs or not local_jobs) {
+            return 0;
+        }
+        return this->migrated_runtime / this->migrated_jobs - this->local_runtime / local_jobs;
+    }
+};
+
+/* Order in which a task serves its pending jobs */
+enum class JobOrder {
+    fifo,
+    /* earliest absolute deadline first, FIFO among equal deadlines */
+    edf,
+};
+
+/* What happens to a job that is already past its deadline when the task gets to it */
+enum class LatePolicy {
+    run,
+    skip,
+    /* run the task's degraded variant instead */
+    degrade,
+};
+
+/* Absolute deadline of a job argument, used for EDF order and late jobs. Overload it for argument
+ * types that carry one. Jobs without a deadline are never late and go last in EDF order. */
+template <typename T>
+time_point job_deadline(const T &arg) {
+    (void)arg;
+    return time_point::max();
+}
+
+/* Id a job is traced and predicted under. Overload it for argument types that carry one, so traces
+ * can be matched with where the job came from. Without one, jobs are numbered in the order they
+ * were added to their task, which is not the order they run in with EDF. */
+template <typename T>
+int job_id(const T &arg, long sequence) {
+    (void)arg;
+    return sequence;
+}
+
+/* a job in a task's queue */
+template <typename T>
+struct PendingJob {
+    T _arg;
+    time_point _deadline;
+    /* arrival order, breaks deadline ties */
+    long _sequence;
+    /* when the job was added, only taken if the task spins for its jobs */
+    time_point _arrival;
+};
+
+/* Per-job callback of tasks that have none */
+template <typename T>
+struct NoCallback {
+    void operator()(T arg) const {
+        (void)arg;
+    }
+
+    explicit operator bool() const {
+        return false;
+    }
+};
+
+/* Whether an optional per-job callback is set. Callables that convert to bool, like function
+ * pointers, are set if they are true, all others always are. Known at compile time for
+ * NoCallback */
+template <typename F>
+bool callback_set(const F &callback) {
+    if constexpr (std::is_constructible_v<bool, const F &>) {
+        return static_cast<bool>(callback);
+    } else {
+        return true;
+    }
+}
+
+/* Forwards the jobs of a pipeline stage to the next stage, see Task::forward_to. Map turns the
+ * argument of a finished job into a std::optional argument of a job of Next */
+template <typename Next, typename Map>
+struct Forwarder {
+    Next *next = nullptr;
+    Map map;
+    FutexSemaphore *credits = nullptr;
+
+    template <typename T>
+    void operator()(T arg) const {
+        this->credits->acquire();
+        auto job = this->map(arg);
+        if (not job) {
+            this->credits->release();
+            return;
+        }
+        this->next->add_job(*job);
+        this->next->sem().release();
+    }
+
+    explicit operator bool() const {
+        return this->next != nullptr;
+    }
+};
+
+/* Metrics generator of tasks without metrics */
+template <typename T>
+struct NoMetrics {
+    std::size_t operator()(T arg, double *metrics, std::size_t capacity) const {
+        (void)arg;
+        (void)metrics;
+        (void)capacity;
+        return 0;
+    }
+};
+
 
 class TaskBase {
   protected:
+    /* most metrics a generator can provide per job */
+    static constexpr std::size_t max_metrics = 16;
+
     int _id;
     bool _prediction_enabled;
     bool _realtime_enabled;
-    std::counting_semaphore<> _sem;
+    FutexSemaphore _sem;
+    WakeupPolicy _wakeup;
+    time_point _last_arrival;
+    BudgetPolicy _budget_policy;
+    /* Policies set while the task thread runs wait here until the task thread takes them over,
+     * before it waits for a job and after it got one */
+    std::mutex _policy_mutex;
+    std::optional<WakeupPolicy> _pending_wakeup;
+    std::optional<BudgetPolicy> _pending_budget_policy;
+    std::atomic<bool> _policy_pending = false;
+    /* whether add_job takes the arrival time, i.e. whether the task spins */
+    std::atomic<bool> _stamp_arrivals = false;
+    BudgetCounters _budget_counters;
+    MigrationCounters _migration_counters;
+    /* CPU the previous job ended on */
+    int _last_cpu = -1;
+    time_point _last_budget_update;
+    /* deadline parameters as last set, so they need not be read back before every update */
+    struct sched_attr _attr;
     duration _execution_time;
     duration _period;
+    /* sched_deadline, at most the period */
+    duration _relative_deadline;
     std::vector<unsigned> _cpus;
 
     time_point _last_checkpoint;
-    std::vector<double> _runtimes;
+    RuntimeHistory _runtimes;
     atlas::estimator _predictor;
 
+    /* per job state lives here so the job path does not allocate */
+    double _metrics[max_metrics];
+    std::size_t _job_path_allocations = 0;
+
+    /* from construction, or from start for pooled tasks, until the thread is set up and waits for
+     * its first job */
+    time_point _created;
+    duration _startup_time;
+    std::atomic<bool> _ready = false;
+
+    /* tasks without a pool get their own thread right away */
+    TaskThreadPool *_pool;
+    std::atomic<bool> _started = false;
     std::thread _thread;
+    /* pooled tasks only, set once run_task returned */
+    std::mutex _finished_mutex;
+    std::condition_variable _finished_cond;
+    bool _finished = false;
     bool _running = true;
     int _pid = 0;
+    int _completion_fd = -1;
+
+    /* pipeline stages: bounds the number of jobs forwarded from the previous stage that are queued
+     * or running here. One credit is returned after each job */
+    std::unique_ptr<FutexSemaphore> _inbound_credits;
     double _result = 1.5;
 
+    /* threads of a pool with the task's cpus are pinned there already */
+    bool pinned_by_pool() const {
+        if (not this->_pool) {
+            return false;
+        }
+        std::vector<unsigned> cpus = this->_cpus;
+        std::sort(cpus.begin(), cpus.end());
+        return cpus == this->_pool->cpus();
+    }
+
+    static void run_pooled(void *task) {
+        TaskBase *self = static_cast<TaskBase *>(task);
+        self->run_task();
+
+        /* the joining thread may delete the task as soon as it sees _finished */
+        std::lock_guard<std::mutex> lock(self->_finished_mutex);
+        self->_finished = true;
+        self->_finished_cond.notify_all();
+    }
+
     void run_task() {
         this->_pid = gettid();
         lttng_ust_tracepoint(task_lib, init_task, this->_id, this->_pid);
 
-        if (not this->_cpus.empty()) {
+        if (not this->_cpus.empty() and this->pinned_by_pool()) {
+            for (const auto &cpu: this->_cpus) {
+                std::cout << "task " << this->_id << " on cpu " << cpu << std::endl;
+            }
+        } else if (not this->_cpus.empty()) {
             cpu_set_t set;
             CPU_ZERO(&set);
 
@@ -76,160 +314,581 @@ class TaskBase {
             if (this->_execution_time > 1us) {
                 attr.sched_runtime = this->_execution_time / 1ns;
             } else {
-                attr.sched_runtime = (0.9*this->_period) / 1ns;
+                attr.sched_runtime = (0.9*this->_relative_deadline) / 1ns;
             }
-            attr.sched_period = attr.sched_deadline = this->_period / 1ns;
+            attr.sched_deadline = this->_relative_deadline / 1ns;
+            attr.sched_period = this->_period / 1ns;
 
             int ret = sched_setattr(0, &attr, flags);
             if (ret < 0) {
                 perror("initial sched_setattr");
                 std::cerr << "runtime: " << attr.sched_runtime << std::endl;
+                std::cerr << "deadline: " << attr.sched_deadline << std::endl;
                 std::cerr << "period: " << attr.sched_period << std::endl;
                 exit(-1);
             }
+            this->_attr = attr;
+            this->_last_budget_update = std::chrono::steady_clock::now();
 
             lttng_ust_tracepoint(task_lib, started_real_time_task, this->_id);
-            sched_yield();
         }
 
+        /* switching to SCHED_DEADLINE starts a fresh period with the full runtime, which a yield
+         * here would only throw away and keep the first job waiting a period */
+        this->_startup_time = std::chrono::steady_clock::now() - this->_created;
+        this->_ready.store(true, std::memory_order_release);
+        this->_ready.notify_all();
+
         /* run jobs if there are some */
-        int job_id = 0;
         while (true) {
             lttng_ust_tracepoint(task_lib, acquire_sem, this->_id);
-            this->_sem.acquire();
+            this->wait_for_job();
             lttng_ust_tracepoint(task_lib, acquired_sem, this->_id);
 
             if (not this->jobs_left()) {
                 this->_running = false;
                 lttng_ust_tracepoint(task_lib, finished_task, this->_id);
+                if (this->_job_path_allocations) {
+                    std::cerr << "task " << this->_id << ": " << this->_job_path_allocations
+                              << " heap allocations on the job path" << std::endl;
+                }
                 break;
             }
-            this->run_job(job_id);
-            job_id++;
+            this->run_job();
+        }
+    }
+
+    /* tell waiters on the completion eventfd that one more job finished */
+    void notify_completion() {
+        if (this->_completion_fd < 0) {
+            return;
+        }
+        uint64_t one = 1;
+        if (write(this->_completion_fd, &one, sizeof(one)) < 0) {
+            perror("write completion eventfd");
+        }
+    }
+
+    void return_inbound_credit() {
+        if (this->_inbound_credits) {
+            this->_inbound_credits->release();
+        }
+    }
+
+    bool budget_update_due(duration runtime, time_point now) const {
+        duration current(this->_attr.sched_runtime);
+        if (runtime == current) {
+            return false;
+        }
+        duration change = runtime > current ? runtime - current : current - runtime;
+        duration relative = std::chrono::duration_cast<duration>(
+                                this->_budget_policy.relative_threshold * current);
+        if (change < std::max(this->_budget_policy.absolute_threshold, relative)) {
+            return false;
+        }
+        if (runtime > current and this->_budget_policy.lower_lazily) {
+            return true;
+        }
+        return now - this->_last_budget_update >= this->_budget_policy.min_interval;
+    }
+
+    /* apply a new runtime prediction to the deadline parameters, if the budget policy says so */
+    void update_budget(duration prediction) {
+        /* the getattr before every update is not needed any more */
+        ++this->_budget_counters.syscalls_saved;
+
+        auto reserved = std::chrono::duration_cast<duration>(
+                            prediction * (1 + this->_budget_policy.headroom));
+        duration runtime = std::min(reserved, duration(this->_attr.sched_deadline));
+        time_point now = std::chrono::steady_clock::now();
+        if (not this->budget_update_due(runtime, now)) {
+            ++this->_budget_counters.skipped;
+            ++this->_budget_counters.syscalls_saved;
+            return;
+        }
+
+        struct sched_attr attr = this->_attr;
+        attr.sched_runtime = runtime / 1ns;
+
+        int ret = sched_setattr(0, &attr, 0);
+        if (ret < 0) {
+            perror("job sched_setattr");
+            std::cerr << "runtime: " << attr.sched_runtime << std::endl;
+            std::cerr << "deadline: " << attr.sched_deadline << std::endl;
+            std::cerr << "period: " << attr.sched_period << std::endl;
+            exit(-1);
+        }
+        this->_attr = attr;
+        this->_last_budget_update = now;
+        ++this->_budget_counters.updates;
+    }
+
+    /* account a job that started on begin_cpu and ended on end_cpu */
+    void count_migrations(int id, int begin_cpu, int end_cpu, duration runtime) {
+        int migrations = 0;
+        if (this->_last_cpu >= 0 and begin_cpu != this->_last_cpu) {
+            lttng_ust_tracepoint(task_lib, migrated_job, this->_id, id, this->_last_cpu, begin_cpu);
+            ++migrations;
+        }
+        if (end_cpu != begin_cpu) {
+            lttng_ust_tracepoint(task_lib, migrated_job, this->_id, id, begin_cpu, end_cpu);
+            ++migrations;
+        }
+        this->_last_cpu = end_cpu;
+
+        ++this->_migration_counters.jobs;
+        if (migrations) {
+            ++this->_migration_counters.migrated_jobs;
+            this->_migration_counters.migrations += migrations;
+            this->_migration_counters.migrated_runtime += runtime / 1ns;
+        } else {
+            this->_migration_counters.local_runtime += runtime / 1ns;
+        }
+    }
+
+    /* on the task thread */
+    void apply_policies() {
+        if (not this->_policy_pending.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(this->_policy_mutex);
+        this->_policy_pending.store(false, std::memory_order_relaxed);
+        if (this->_pending_wakeup) {
+            this->_wakeup = *this->_pending_wakeup;
+            this->_pending_wakeup.reset();
+        }
+        if (this->_pending_budget_policy) {
+            this->_budget_policy = *this->_pending_budget_policy;
+            this->_pending_budget_policy.reset();
+        }
+    }
+
+    /* the arrival time of a job added now, for the wakeup policy. Only taken if the task spins */
+    time_point arrival() const {
+        return this->_stamp_arrivals.load(std::memory_order_relaxed)
+               ? std::chrono::steady_clock::now() : time_point();
+    }
+
+    /* _last_arrival is the arrival of the previous job as the producer saw it, so the time it
+     * spent queued and running does not shift the expected next arrival */
+    void wait_for_job() {
+        this->apply_policies();
+        duration spin = this->_wakeup.spin;
+        if (spin > 0ns and this->_period > 0ns and this->_last_arrival != time_point()) {
+            auto until_next = this->_last_arrival + this->_period - std::chrono::steady_clock::now();
+            if (until_next > spin) {
+                spin = 0ns;
+            }
         }
+        this->_sem.acquire(spin);
+        this->apply_policies();
     }
 
-    virtual void run_job(int id) = 0;
+    virtual void run_job() = 0;
 
     virtual bool jobs_left() = 0;
 
     TaskBase(int id, bool prediction_enabled, bool realtime_enabled, duration execution_time, duration period,
-             std::vector<unsigned> cpus)
+             duration relative_deadline, std::vector<unsigned> cpus, TaskThreadPool *pool)
         : _id(id), _prediction_enabled(prediction_enabled), _realtime_enabled(realtime_enabled),
-          _sem(0), _execution_time(execution_time), _period(period), _cpus(cpus) {
-            this->_thread = std::thread(&TaskBase::run_task, this);
+          _sem(0), _execution_time(execution_time), _period(period),
+          _relative_deadline(relative_deadline), _cpus(cpus),
+          _created(std::chrono::steady_clock::now()), _pool(pool) {
+            if (not this->_pool) {
+                this->_started = true;
+                this->_thread = std::thread(&TaskBase::run_task, this);
+            }
         }
 
   public:
+    /* Take a thread from the task's pool and set it up. The first job does this for pooled tasks
+     * on its own, so this is only needed to get a task ready ahead of its first job. Safe to call
+     * from several threads */
+    void start() {
+        if (this->_started.load(std::memory_order_acquire) or this->_started.exchange(true)) {
+            return;
+        }
+        this->_created = std::chrono::steady_clock::now();
+        this->_pool->run(&TaskBase::run_pooled, this);
+    }
+
+    /* like for a thread of its own, the semaphore has to be released for the task to finish. A
+     * pooled task without jobs gets started for that */
     void join() {
-        this->_thread.join();
+        if (not this->_pool) {
+            this->_thread.join();
+            return;
+        }
+        this->start();
+        std::unique_lock<std::mutex> lock(this->_finished_mutex);
+        this->_finished_cond.wait(lock, [this] { return this->_finished; });
     }
 
     int id() const {
         return this->_id;
     }
 
-    std::counting_semaphore<> &sem() {
+    FutexSemaphore &sem() {
         return this->_sem;
     }
 
+    /* Block until the task thread has set its affinity and scheduling parameters. Jobs added
+     * before are not lost, but may wait for the task to get there. Starts a pooled task that has
+     * not started yet */
+    void wait_until_ready() {
+        this->start();
+        this->_ready.wait(false, std::memory_order_acquire);
+    }
+
+    /* time the task took to get ready, valid once wait_until_ready returned */
+    duration startup_time() const {
+        return this->_startup_time;
+    }
+
+    /* Takes effect the next time the task waits for a job. Set it before the first job is added
+     * for it to apply from the start */
+    void set_wakeup_policy(WakeupPolicy policy) {
+        std::lock_guard<std::mutex> lock(this->_policy_mutex);
+        this->_pending_wakeup = policy;
+        this->_stamp_arrivals.store(policy.spin > 0ns, std::memory_order_relaxed);
+        this->_policy_pending.store(true, std::memory_order_release);
+    }
+
+    /* eventfd that counts finished jobs. Reading it returns the number of jobs finished since the
+     * last read, so it can be waited on with poll/select/epoll. Created on first call, which has
+     * to happen before the first job is added. */
+    int completion_fd() {
+        if (this->_completion_fd < 0) {
+            this->_completion_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            if (this->_completion_fd < 0) {
+                perror("eventfd");
+                exit(-1);
+            }
+        }
+        return this->_completion_fd;
+    }
+
+    /* make this task a pipeline stage that accepts at most max_pending forwarded jobs at once.
+     * Returns the credits the previous stage has to take before forwarding a job. */
+    FutexSemaphore &limit_inbound(std::size_t max_pending) {
+        this->_inbound_credits = std::make_unique<FutexSemaphore>(max_pending);
+        return *this->_inbound_credits;
+    }
+
     duration period() const {
         return this->_period;
     }
+
+    duration relative_deadline() const {
+        return this->_relative_deadline;
+    }
+
+    /* cpus the task is pinned to, empty if it may run anywhere */
+    const std::vector<unsigned> &cpus() const {
+        return this->_cpus;
+    }
+
+    /* Takes effect with the next job. Set it before the first job is added for it to apply from
+     * the start */
+    void set_budget_policy(BudgetPolicy policy) {
+        std::lock_guard<std::mutex> lock(this->_policy_mutex);
+        this->_pending_budget_policy = policy;
+        this->_policy_pending.store(true, std::memory_order_release);
+    }
+
+    /* only consistent once the task finished */
+    BudgetCounters budget_counters() const {
+        return this->_budget_counters;
+    }
+
+    /* read after join. Migrations between jobs are only seen at job boundaries, so a job that
+     * moved several times while running counts once */
+    MigrationCounters migration_counters() const {
+        return this->_migration_counters;
+    }
+
+    /* runtime statistics of all jobs so far. Safe to call from any thread while the task runs */
+    RuntimeStats runtime_stats() const {
+        return this->_runtimes.stats();
+    }
+
+    /* approximate q-quantile of the runtimes, 0 < q <= 1. Safe to call from any thread */
+    double runtime_percentile(double q) const {
+        return this->_runtimes.percentile(q);
+    }
+
+    /* copy up to n of the most recent runtimes (at most runtime_history_capacity) to out, oldest
+     * first. Returns how many were copied. Safe to call from any thread */
+    std::size_t recent_runtimes(double *out, std::size_t n) const {
+        return this->_runtimes.recent(out, n);
+    }
+
+    /* heap allocations made by the task library itself while running jobs, i.e. not counting the
+     * job functions. Only counted in debug builds */
+    std::size_t job_path_allocations() const {
+        return this->_job_path_allocations;
+    }
 };
 
-template <typename T>
+/* Jobs are handed from the spawning thread to the task thread through a bounded lock-free ring.
+ * The default ring allows exactly one thread to call add_job. Use MpscRing as Queue if jobs are
+ * added from several threads.
+ *
+ * Jobs are served in FIFO order unless the task is switched to EDF order. Then the task thread
+ * moves arriving jobs from the ring into a deadline heap of the same capacity. Late jobs can be
+ * skipped or degraded in either order.
+ *
+ * All callables are called for every job, so they are stored as they are instead of behind
+ * std::function. Execute is called with the job's argument, Generate with the argument, a buffer
+ * and its capacity and returns the number of metrics it wrote. The optional ones, Complete, Degrade
+ * and Forward, are called with the job's argument if they are set (see callback_set) and default
+ * to NoCallback, which costs nothing.
+ *
+ * Without a pool every task creates its thread at construction. With one, the task takes a thread
+ * from the pool on its first job, or on start, and the thread goes back to the pool after join. */
+template <typename T, template <typename> class Queue = SpscRing, typename Execute = void (*)(T),
+          typename Generate = NoMetrics<T>, typename Complete = NoCallback<T>,
+          typename Degrade = NoCallback<T>, typename Forward = NoCallback<T>>
 class Task : public TaskBase {
-    std::function<std::vector<double> (T)> _generate;
-    std::function<void (T)> _execute;
-    std::queue<T> _jobs;
+    Generate _generate;
+    Execute _execute;
+    Degrade _degrade;
+    Complete _complete;
+    Forward _forward;
+    Queue<PendingJob<T>> _jobs;
+
+    JobOrder _order = JobOrder::fifo;
+    LatePolicy _late_policy = LatePolicy::run;
+    /* EDF order only. Reserved up front, never grows beyond that */
+    std::vector<PendingJob<T>> _deadline_heap;
+    long _n_arrived = 0;
+
+    static bool later(const PendingJob<T> &a, const PendingJob<T> &b) {
+        return std::tie(a._deadline, a._sequence) > std::tie(b._deadline, b._sequence);
+    }
 
-    void run_job(int id) override {
+    PendingJob<T> next_job() {
+        PendingJob<T> job;
+        if (this->_order == JobOrder::fifo) {
+            this->_jobs.try_pop(&job);
+            job._sequence = this->_n_arrived++;
+            return job;
+        }
+
+        while (this->_deadline_heap.size() < this->_deadline_heap.capacity()
+               and this->_jobs.try_pop(&job)) {
+            job._sequence = this->_n_arrived++;
+            this->_deadline_heap.push_back(job);
+            std::push_heap(this->_deadline_heap.begin(), this->_deadline_heap.end(), later);
+        }
+        std::pop_heap(this->_deadline_heap.begin(), this->_deadline_heap.end(), later);
+        job = this->_deadline_heap.back();
+        this->_deadline_heap.pop_back();
+        return job;
+    }
+
+    /* everything that has to happen after a job, whether it ran or not */
+    void finish_job(T arg, bool ran) {
+        if (ran and callback_set(this->_complete)) {
+            this->_complete(arg);
+        }
+        /* may wait for the next stage. Holding on to our own credit meanwhile passes the
+         * back-pressure on to the previous stage */
+        if (callback_set(this->_forward)) {
+            this->_forward(arg);
+        }
+        this->return_inbound_credit();
+        this->notify_completion();
+    }
+
+    void run_job() override {
         /* get jobs parameters */
-        T arg = this->_jobs.front();
-        this->_jobs.pop();
+        std::size_t allocations = thread_allocations();
+        PendingJob<T> job = this->next_job();
+        T arg = job._arg;
+        int id = job_id(arg, job._sequence);
+        if (job._arrival != time_point()) {
+            this->_last_arrival = job._arrival;
+        }
+
+        bool late = this->_late_policy != LatePolicy::run
+                    and job._deadline != time_point::max()
+                    and std::chrono::steady_clock::now() > job._deadline;
+        if (late and this->_late_policy == LatePolicy::skip) {
+            lttng_ust_tracepoint(task_lib, skipped_job, this->_id, id);
+            this->finish_job(arg, false);
+            this->_job_path_allocations += thread_allocations() - allocations;
+            return;
+        }
+        bool degraded = late and callback_set(this->_degrade);
+
         if (this->_prediction_enabled and this->_realtime_enabled) {
-            std::vector<double> metrics = this->_generate(arg);
-            duration prediction  = this->_predictor.predict(0, id, metrics.data(), metrics.size());
-            /* first prediction is always 90% of the period. It will most likely not take this time
+            std::size_t n_metrics = std::min(this->_generate(arg, this->_metrics, max_metrics),
+                                             max_metrics);
+            duration prediction  = this->_predictor.predict(0, id, this->_metrics, n_metrics);
+            /* first prediction is always 90% of the deadline. It will most likely not take this time
              * but we make sure to get the first measurement asap. 90% is already configured at
              * initialisation if prediction is enabled, so here goes only the first checkpoint */
-            if (not this->_runtimes.size()) {
+            if (not this->_runtimes.count()) {
                 this->_last_checkpoint = thread_now();
             } else {
 
                 lttng_ust_tracepoint(task_lib, prediction, this->_id, id, prediction / 1ns);
 
                 /* configure deadline scheduling */
-                struct sched_attr attr;
-                sched_getattr(gettid(), &attr, sizeof(attr), 0);
-
-                attr.sched_runtime = prediction / 1ns;
-                attr.sched_runtime = std::min(attr.sched_runtime, attr.sched_period);
-
-                int ret = sched_setattr(0, &attr, 0);
-                if (ret < 0) {
-                    perror("job sched_setattr");
-                    std::cerr << "runtime: " << attr.sched_runtime << std::endl;
-                    std::cerr << "period: " << attr.sched_period << std::endl;
-                    exit(-1);
-                }
+                this->update_budget(prediction);
             }
         }
 
         lttng_ust_tracepoint(task_lib, begin_job, this->_id, id);
-
-        this->_execute(arg);
+        int begin_cpu = sched_getcpu();
+
+        this->_job_path_allocations += thread_allocations() - allocations;
+        if (degraded) {
+            lttng_ust_tracepoint(task_lib, degraded_job, this->_id, id);
+            this->_degrade(arg);
+        } else {
+            this->_execute(arg);
+        }
+        allocations = thread_allocations();
+        int end_cpu = sched_getcpu();
 
         time_point now = thread_now();
         auto runtime = now - this->_last_checkpoint;
         this->_last_checkpoint = now;
 
-        this->_runtimes.push_back(runtime / 1ns);
-        if (this->_prediction_enabled and this->_realtime_enabled) {
+        this->_runtimes.add(runtime / 1ns);
+        /* degraded runs say nothing about the job's real runtime */
+        if (this->_prediction_enabled and this->_realtime_enabled and not degraded) {
             this->_predictor.train(0, id, duration_cast<std::chrono::nanoseconds>(
                                           std::chrono::duration<double>{runtime} + 0.5ns));
         }
         lttng_ust_tracepoint(task_lib, end_job, this->_id, id, runtime / 1ns);
-        if (this->_prediction_enabled and this->_realtime_enabled and this->_runtimes.size() == 1) {
+        this->count_migrations(id, begin_cpu, end_cpu, runtime);
+
+        this->finish_job(arg, true);
+        this->_job_path_allocations += thread_allocations() - allocations;
+
+        if (this->_prediction_enabled and this->_realtime_enabled and this->_runtimes.count() == 1) {
             sched_yield();
         }
     }
 
     bool jobs_left() override {
-        return not this->_jobs.empty();
+        return not this->_jobs.empty() or not this->_deadline_heap.empty();
     };
 
   public:
     /* Non real-time task */
-    Task(int id, std::function<void (T)> execute,
-         std::vector<unsigned> cpus = std::vector<unsigned>())
-        : TaskBase(id, false, false, duration(0), duration(0), cpus),
+    Task(int id, Execute execute, std::vector<unsigned> cpus = std::vector<unsigned>(),
+         TaskThreadPool *pool = nullptr)
+        : TaskBase(id, false, false, duration(0), duration(0), duration(0), cpus, pool),
           _execute(execute) {}
 
     /* task without prediction */
-    Task(int id, duration period, std::function<void (T)> execute,
-         duration execution_time, std::vector<unsigned> cpus = std::vector<unsigned>())
-        : TaskBase(id, false, true, execution_time, period, cpus),
+    Task(int id, duration period, Execute execute, duration execution_time,
+         std::vector<unsigned> cpus = std::vector<unsigned>(),
+         TaskThreadPool *pool = nullptr)
+        : TaskBase(id, false, true, execution_time, period, period, cpus, pool),
+          _execute(execute) {}
+
+    /* task without prediction whose jobs are due before the end of the period */
+    Task(int id, duration period, duration relative_deadline, Execute execute,
+         duration execution_time, std::vector<unsigned> cpus = std::vector<unsigned>(),
+         TaskThreadPool *pool = nullptr)
+        : TaskBase(id, false, true, execution_time, period, relative_deadline, cpus, pool),
           _execute(execute) {}
 
     /* task with prediction but without metrics */
-    Task(int id, duration period, std::function<void (T)> execute,
-         std::vector<unsigned> cpus = std::vector<unsigned>())
-        : TaskBase(id, true, true, duration(0), period, cpus),
-          _execute(execute) {
-            this->_generate = [](T t) { (void)t; return std::vector<double>(); };
-        }
+    Task(int id, duration period, Execute execute,
+         std::vector<unsigned> cpus = std::vector<unsigned>(),
+         TaskThreadPool *pool = nullptr)
+        : TaskBase(id, true, true, duration(0), period, period, cpus, pool),
+          _execute(execute) {}
+
+    /* task with prediction but without metrics whose jobs are due before the end of the period */
+    Task(int id, duration period, duration relative_deadline, Execute execute,
+         std::vector<unsigned> cpus = std::vector<unsigned>(),
+         TaskThreadPool *pool = nullptr)
+        : TaskBase(id, true, true, duration(0), period, relative_deadline, cpus, pool),
+          _execute(execute) {}
 
     /* task with prediction and metrics */
-    Task(int id, duration period, std::function<void (T)> execute,
-         std::function<std::vector<double> (T)> generate,
-         std::vector<unsigned> cpus = std::vector<unsigned>())
-        : TaskBase(id, true, true, duration(0), period, cpus),
+    Task(int id, duration period, Execute execute, Generate generate,
+         std::vector<unsigned> cpus = std::vector<unsigned>(),
+         TaskThreadPool *pool = nullptr)
+        : TaskBase(id, true, true, duration(0), period, period, cpus, pool),
           _generate(generate),
           _execute(execute) {}
 
+    /* Serve pending jobs in this order. Set before the first job is added */
+    void set_job_order(JobOrder order) {
+        this->_order = order;
+        if (order == JobOrder::edf) {
+            this->_deadline_heap.reserve(this->_jobs.capacity());
+        }
+    }
+
+    /* What to do with jobs that are past their deadline when the task gets to them. degrade is run
+     * instead of the job with LatePolicy::degrade; without it late jobs run normally. Set before
+     * the first job is added */
+    void set_late_policy(LatePolicy policy, Degrade degrade = Degrade()) {
+        this->_late_policy = policy;
+        this->_degrade = degrade;
+    }
+
+    /* called on the task thread with the job's argument after each job that ran, degraded or not.
+     * Skipped jobs do not count. Set before the first job is added */
+    void set_completion_callback(Complete complete) {
+        this->_complete = complete;
+    }
+
+    /* Connect this task to next as consecutive pipeline stages. After each job, map turns the
+     * job's argument into a job of next, which is added to next right from this task's thread. At
+     * most max_pending forwarded jobs are queued or running at next at any time; beyond that this
+     * task waits before forwarding. Returning nullopt forwards nothing. next must not get jobs from
+     * anywhere else. The task has to be declared with Forwarder<Next, Map> as Forward. Set up
+     * before the first job is added to either task. */
+    template <typename Next, typename Map>
+    void forward_to(Next *next, Map map, std::size_t max_pending) {
+        static_assert(std::is_same_v<Forward, Forwarder<Next, Map>>,
+                      "forwarding tasks take Forwarder<Next, Map> as Forward");
+        this->_forward = Forwarder<Next, Map>{next, map, &next->limit_inbound(max_pending)};
+    }
+
+    /* wait for the task thread to make room if the queue is full. Starts a pooled task */
+    void add_job(T arg, time_point deadline) {
+        this->start();
+        PendingJob<T> job{arg, deadline, 0, this->arrival()};
+        while (not this->_jobs.try_push(job)) {
+            std::this_thread::yield();
+        }
+    }
+
     void add_job(T arg) {
-        this->_jobs.push(arg);
+        this->add_job(arg, job_deadline(arg));
+    }
+
+    /* enqueue all jobs and wake the task thread once. Unlike add_job this releases the semaphore
+     * for the whole batch. A batch larger than the free space in the queue is released in parts,
+     * as the task thread has to take jobs out before the rest fits */
+    void add_jobs(std::span<const T> args) {
+        this->start();
+        time_point arrival = this->arrival();
+        std::size_t unreleased = 0;
+        for (const T &arg: args) {
+            PendingJob<T> job{arg, job_deadline(arg), 0, arrival};
+            while (not this->_jobs.try_push(job)) {
+                if (unreleased) {
+                    this->_sem.release(unreleased);
+                    unreleased = 0;
+                }
+                std::this_thread::yield();
+            }
+            ++unreleased;
+        }
+        if (unreleased) {
+            this->_sem.release(unreleased);
+        }
     }
 };
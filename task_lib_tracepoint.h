@@ -122,6 +122,49 @@ LTTNG_UST_TRACEPOINT_EVENT(
     )
 )
 
+LTTNG_UST_TRACEPOINT_EVENT(
+    task_lib,
+    skipped_job,
+    LTTNG_UST_TP_ARGS(
+        int, task_arg,
+        int, job_arg
+    ),
+    LTTNG_UST_TP_FIELDS(
+        lttng_ust_field_integer(char, task, task_arg)
+        lttng_ust_field_integer(int, job, job_arg)
+    )
+)
+
+LTTNG_UST_TRACEPOINT_EVENT(
+    task_lib,
+    degraded_job,
+    LTTNG_UST_TP_ARGS(
+        int, task_arg,
+        int, job_arg
+    ),
+    LTTNG_UST_TP_FIELDS(
+        lttng_ust_field_integer(char, task, task_arg)
+        lttng_ust_field_integer(int, job, job_arg)
+    )
+)
+
+LTTNG_UST_TRACEPOINT_EVENT(
+    task_lib,
+    migrated_job,
+    LTTNG_UST_TP_ARGS(
+        int, task_arg,
+        int, job_arg,
+        int, from_cpu_arg,
+        int, to_cpu_arg
+    ),
+    LTTNG_UST_TP_FIELDS(
+        lttng_ust_field_integer(char, task, task_arg)
+        lttng_ust_field_integer(int, job, job_arg)
+        lttng_ust_field_integer(int, from_cpu, from_cpu_arg)
+        lttng_ust_field_integer(int, to_cpu, to_cpu_arg)
+    )
+)
+
 
 #endif /* _TASK_LIB_TP_H */
 
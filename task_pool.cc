@@ -0,0 +1,181 @@
+#include "task_pool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sched.h>
+
+#include "rt.h"
+
+/* the affinity of the process before any of its threads pinned itself. Threads are started
+ * lazily, often by a thread that is pinned by then */
+static const cpu_set_t process_set = [] {
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+        perror("sched_getaffinity");
+        exit(-1);
+    }
+    return set;
+}();
+
+TaskThreadPool::TaskThreadPool(std::vector<unsigned> cpus, std::size_t prestart)
+    : _cpus(cpus) {
+    std::sort(this->_cpus.begin(), this->_cpus.end());
+
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    for (std::size_t i = 0; i < prestart; ++i) {
+        this->_idle.push_back(this->add_worker());
+    }
+}
+
+TaskThreadPool::~TaskThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_stopping = true;
+        for (Worker *worker: this->_idle) {
+            worker->body = nullptr;
+            worker->wakeup.release();
+        }
+        this->_idle.clear();
+    }
+    /* busy workers stop once their body returned */
+    for (auto &worker: this->_workers) {
+        worker->thread.join();
+    }
+}
+
+TaskThreadPool::Worker *TaskThreadPool::add_worker() {
+    auto worker = std::make_unique<Worker>();
+    worker->thread = std::thread(&TaskThreadPool::work, this, worker.get());
+    this->_workers.push_back(std::move(worker));
+    return this->_workers.back().get();
+}
+
+void TaskThreadPool::run(void (*body)(void *), void *arg) {
+    Worker *worker;
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        if (this->_idle.empty()) {
+            worker = this->add_worker();
+        } else {
+            worker = this->_idle.back();
+            this->_idle.pop_back();
+            if (worker->body) {
+                ++this->_reused;
+            }
+        }
+        worker->body = body;
+        worker->arg = arg;
+    }
+    worker->wakeup.release();
+}
+
+std::size_t TaskThreadPool::threads() {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    return this->_workers.size();
+}
+
+std::size_t TaskThreadPool::reused() {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    return this->_reused;
+}
+
+void TaskThreadPool::work(Worker *worker) {
+    cpu_set_t pool_set = process_set;
+    if (not this->_cpus.empty()) {
+        CPU_ZERO(&pool_set);
+        for (unsigned cpu: this->_cpus) {
+            CPU_SET(cpu, &pool_set);
+        }
+    }
+    if (sched_setaffinity(0, sizeof(pool_set), &pool_set) < 0) {
+        perror("sched_setaffinity");
+        exit(-1);
+    }
+
+    /* what every body starts with */
+    cpu_set_t home_set;
+    if (sched_getaffinity(0, sizeof(home_set), &home_set) < 0) {
+        perror("sched_getaffinity");
+        exit(-1);
+    }
+    struct sched_attr home_attr = {};
+    if (sched_getattr(0, &home_attr, sizeof(home_attr), 0) < 0) {
+        perror("sched_getattr");
+        exit(-1);
+    }
+    home_attr.size = sizeof(home_attr);
+
+    while (true) {
+        worker->wakeup.acquire();
+        if (worker->body == nullptr) {
+            return;
+        }
+        worker->body(worker->arg);
+
+        /* a deadline thread may not change its affinity, so the policy goes first */
+        struct sched_attr attr = {};
+        if (sched_getattr(0, &attr, sizeof(attr), 0) < 0) {
+            perror("sched_getattr");
+            exit(-1);
+        }
+        if (attr.sched_policy != home_attr.sched_policy) {
+            if (sched_setattr(0, &home_attr, 0) < 0) {
+                perror("reset sched_setattr");
+                exit(-1);
+            }
+        }
+        cpu_set_t set;
+        if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+            perror("sched_getaffinity");
+            exit(-1);
+        }
+        if (not CPU_EQUAL(&set, &home_set)) {
+            if (sched_setaffinity(0, sizeof(home_set), &home_set) < 0) {
+                perror("reset sched_setaffinity");
+                exit(-1);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        if (this->_stopping) {
+            return;
+        }
+        this->_idle.push_back(worker);
+    }
+}
+
+void TaskThreadPools::preconfigure(const std::vector<unsigned> &cpus, std::size_t prestart) {
+    for (unsigned cpu: cpus) {
+        auto &pool = this->_pools[{cpu}];
+        if (not pool) {
+            pool = std::make_unique<TaskThreadPool>(std::vector<unsigned>{cpu}, prestart);
+        }
+    }
+}
+
+TaskThreadPool *TaskThreadPools::pool_for(std::vector<unsigned> cpus) {
+    std::sort(cpus.begin(), cpus.end());
+    auto &pool = this->_pools[cpus];
+    if (not pool) {
+        pool = std::make_unique<TaskThreadPool>(cpus);
+    }
+    return pool.get();
+}
+
+std::size_t TaskThreadPools::threads() {
+    std::size_t threads = 0;
+    for (auto &[_, pool]: this->_pools) {
+        threads += pool->threads();
+    }
+    return threads;
+}
+
+std::size_t TaskThreadPools::reused() {
+    std::size_t reused = 0;
+    for (auto &[_, pool]: this->_pools) {
+        reused += pool->reused();
+    }
+    return reused;
+}
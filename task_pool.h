@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "futex_semaphore.h"
+
+
+/* Threads that run task bodies one after another, so creating a task does not cost a thread, its
+ * stack and an affinity syscall every time.
+ *
+ * A thread of a pool with cpus is pinned to them once when it is created, so tasks pinned to the
+ * same cpus need not set their affinity again. Threads of a pool without cpus get the affinity the
+ * process started with, not that of whichever thread happened to start them. After each body the thread drops a SCHED_DEADLINE
+ * policy the body left behind and moves back to the pool's cpus before it waits for the next one.
+ * Threads are only created when no idle one is left, or up front with prestart. */
+class TaskThreadPool {
+    struct Worker {
+        FutexSemaphore wakeup{0};
+        /* nullptr stops the worker */
+        void (*body)(void *) = nullptr;
+        void *arg = nullptr;
+        std::thread thread;
+    };
+
+    /* sorted, empty for threads on the cpus the process started with */
+    std::vector<unsigned> _cpus;
+
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<Worker *> _idle;
+    bool _stopping = false;
+    std::size_t _reused = 0;
+
+    /* with _mutex held */
+    Worker *add_worker();
+
+    void work(Worker *worker);
+
+  public:
+    explicit TaskThreadPool(std::vector<unsigned> cpus = std::vector<unsigned>(),
+                            std::size_t prestart = 0);
+
+    /* Every body has to return before, as joining its task guarantees */
+    ~TaskThreadPool();
+
+    TaskThreadPool(const TaskThreadPool &) = delete;
+    TaskThreadPool &operator=(const TaskThreadPool &) = delete;
+
+    /* call body(arg) on an idle thread, or on a new one if all are busy */
+    void run(void (*body)(void *), void *arg);
+
+    const std::vector<unsigned> &cpus() const {
+        return this->_cpus;
+    }
+
+    /* threads created so far */
+    std::size_t threads();
+
+    /* bodies that ran on a thread an earlier body had already used */
+    std::size_t reused();
+};
+
+/* One pool per set of cpus. Tasks pinned to the same cpus share the threads of one pool. Not
+ * thread safe, tasks are created from one thread. */
+class TaskThreadPools {
+    std::map<std::vector<unsigned>, std::unique_ptr<TaskThreadPool>> _pools;
+
+  public:
+    /* start prestart threads pinned to each single one of cpus ahead of the tasks */
+    void preconfigure(const std::vector<unsigned> &cpus, std::size_t prestart);
+
+    /* the pool for tasks pinned to cpus, created without threads if there is none yet */
+    TaskThreadPool *pool_for(std::vector<unsigned> cpus);
+
+    std::size_t threads();
+    std::size_t reused();
+};